@@ -6,6 +6,7 @@ project "shader_editor"
 		"src/**.h",
 		"genie.lua"
 	}
+	excludes { "src/tools/**" }
 	defines { "BUILDING_SHADER_EDITOR" }
 	links { "editor", "engine", "renderer", "core" }
 	if build_studio then
@@ -14,3 +15,28 @@ project "shader_editor"
 	defaultConfigurations()
 	
 linkPlugin("shader_editor")
+
+-- generates shaders from graphs without the studio, shares the codegen with the plugin, but not the GUI
+project "shader_graph_compiler"
+	kind "ConsoleApp"
+	files {
+		"src/editor/shader_graph.cpp",
+		"src/editor/shader_graph.h",
+		"src/tools/shader_graph_compiler.cpp",
+		"genie.lua"
+	}
+	defines { "LUMIX_SHADER_GRAPH_HEADLESS" }
+	links { "engine", "core" }
+	defaultConfigurations()
+
+project "shader_graph_benchmark"
+	kind "ConsoleApp"
+	files {
+		"src/editor/shader_graph.cpp",
+		"src/editor/shader_graph.h",
+		"src/tools/shader_graph_benchmark.cpp",
+		"genie.lua"
+	}
+	defines { "LUMIX_SHADER_GRAPH_HEADLESS" }
+	links { "engine", "core" }
+	defaultConfigurations()
@@ -0,0 +1,4578 @@
+#include "core/crt.h"
+#include "core/hash.h"
+#include "core/job_system.h"
+#include "core/log.h"
+#include "core/math.h"
+#include "core/os.h"
+#include "engine/file_system.h"
+#include "renderer/gpu/gpu.h"
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	#include "editor/studio_app.h"
+	#include "renderer/editor/particle_editor.h"
+	#include "renderer/shader.h"
+	#include "imgui/IconsFontAwesome5.h"
+#endif
+#include "shader_graph.h"
+
+
+namespace Lumix {
+
+ResourceType ShaderEditorResource::TYPE("shader_graph");
+
+namespace {
+
+#ifdef LUMIX_SHADER_GRAPH_HEADLESS
+// renderer is not linked in headless build, names must be the same as from Shader::toTextureVarName and Shader::toUniformVarName
+static void toVarName(Span<char> out, const char* prefix, const char* in) {
+	copyString(out, prefix);
+	char* o = out.begin() + stringLength(prefix);
+	for (const char* c = in; *c && o < out.end() - 1; ++c) {
+		*o = isLetter(*c) || isNumeric(*c) ? *c : '_';
+		++o;
+	}
+	*o = '\0';
+}
+
+static void toTextureVarName(Span<char> out, const char* in) { toVarName(out, "t_", in); }
+static void toUniformVarName(Span<char> out, const char* in) { toVarName(out, "u_", in); }
+#else
+static void toTextureVarName(Span<char> out, const char* in) { Shader::toTextureVarName(out, in); }
+static void toUniformVarName(Span<char> out, const char* in) { Shader::toUniformVarName(out, in); }
+#endif
+
+struct VertexOutput {
+	ShaderEditorResource::ValueType type;
+	StaticString<32> name;
+};
+
+static ShaderEditorResource::ValueType toType(const gpu::Attribute& attr) {
+	switch (attr.type) {
+		case gpu::AttributeType::FLOAT:
+			break;
+		case gpu::AttributeType::I16:
+		case gpu::AttributeType::I8:
+			if (attr.flags & gpu::Attribute::AS_INT) {
+				switch (attr.components_count) {
+					case 1: return ShaderEditorResource::ValueType::INT;
+					case 2: ASSERT(false); break;
+					case 3: ASSERT(false); break;
+					case 4: return ShaderEditorResource::ValueType::IVEC4;
+				}
+				ASSERT(false);
+				return ShaderEditorResource::ValueType::NONE;
+			}
+			break;
+		case gpu::AttributeType::U8:
+			if (attr.flags & gpu::Attribute::AS_INT) {
+				switch (attr.components_count) {
+					case 1: ASSERT(false); break;
+					case 2: ASSERT(false); break;
+					case 3: ASSERT(false); break;
+					case 4: ASSERT(false); break;
+				}
+				ASSERT(false);
+				return ShaderEditorResource::ValueType::NONE;
+			}
+			break;
+	}
+	switch (attr.components_count) {
+		case 1: return ShaderEditorResource::ValueType::FLOAT;
+		case 2: return ShaderEditorResource::ValueType::VEC2;
+		case 3: return ShaderEditorResource::ValueType::VEC3;
+		case 4: return ShaderEditorResource::ValueType::VEC4;
+	}
+	ASSERT(false);
+	return ShaderEditorResource::ValueType::NONE;
+}
+
+static constexpr const char* toString(ShaderEditorResource::ValueType type) {
+	switch (type) {
+		case ShaderEditorResource::ValueType::COUNT:
+		case ShaderEditorResource::ValueType::NONE:
+			return "error";
+		case ShaderEditorResource::ValueType::BOOL: return "bool";
+		case ShaderEditorResource::ValueType::INT: return "int";
+		case ShaderEditorResource::ValueType::FLOAT: return "float";
+		case ShaderEditorResource::ValueType::VEC2: return "vec2";
+		case ShaderEditorResource::ValueType::VEC3: return "vec3";
+		case ShaderEditorResource::ValueType::VEC4: return "vec4";
+		case ShaderEditorResource::ValueType::IVEC4: return "ivec4";
+	}
+	ASSERT(false);
+	return "Unknown type";
+}
+
+// qualifier of a temporary declared by `node`, GLSL allows precision only on float types
+static const char* toPrecision(const ShaderEditorResource::Node& node, ShaderEditorResource::ValueType type) {
+	if (!node.m_low_precision) return "";
+	switch (type) {
+		case ShaderEditorResource::ValueType::FLOAT:
+		case ShaderEditorResource::ValueType::VEC2:
+		case ShaderEditorResource::ValueType::VEC3:
+		case ShaderEditorResource::ValueType::VEC4:
+			return "mediump ";
+		default: return "";
+	}
+}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+static bool edit(const char* label, ShaderEditorResource::ValueType* type) {
+	bool changed = false;
+	if (ImGui::BeginCombo(label, toString(*type))) {
+		if (ImGui::Selectable("bool")) { *type = ShaderEditorResource::ValueType::BOOL; changed = true; }
+		if (ImGui::Selectable("int")) { *type = ShaderEditorResource::ValueType::INT; changed = true; }
+		if (ImGui::Selectable("float")) { *type = ShaderEditorResource::ValueType::FLOAT; changed = true; }
+		if (ImGui::Selectable("vec2")) { *type = ShaderEditorResource::ValueType::VEC2; changed = true; }
+		if (ImGui::Selectable("vec3")) { *type = ShaderEditorResource::ValueType::VEC3; changed = true; }
+		if (ImGui::Selectable("vec4")) { *type = ShaderEditorResource::ValueType::VEC4; changed = true; }
+		ImGui::EndCombo();
+	}
+	return changed;
+}
+#endif
+
+struct Input {
+	ShaderEditorResource::Node* node = nullptr;
+	u16 output_idx;
+
+	void printReference(OutputMemoryStream& blob) const;
+	operator bool() const { return node != nullptr; }
+};
+
+static Input getInput(const ShaderEditorResource& resource, u16 node_id, u16 input_idx) {
+	Input res;
+	const ShaderEditorResource::Node* node = resource.getNode(node_id);
+	if (!node) return res;
+	const i32 link_idx = resource.getInputLink(*node, input_idx);
+	if (link_idx < 0) return res;
+
+	const ShaderEditorResource::Link& link = resource.m_links[link_idx];
+	res.output_idx = link.getFromPin();
+	res.node = resource.getNode(link.getFromNode());
+	while (res.node && res.node->m_alias) {
+		if (res.node->m_alias_output >= 0) res.output_idx = (u16)res.node->m_alias_output;
+		res.node = res.node->m_alias;
+	}
+	return res;
+}
+
+static bool isOutputConnected(const ShaderEditorResource& resource, u16 node_id, u16 input_idx) {
+	const ShaderEditorResource::Node* node = resource.getNode(node_id);
+	if (!node) return false;
+	for (u32 link_idx : node->m_output_links) {
+		if (resource.m_links[link_idx].getFromPin() == input_idx) return true;
+	}
+	return false;
+}
+
+static bool isInputConnected(const ShaderEditorResource& resource, u16 node_id, u16 input_idx) {
+	return getInput(resource, node_id, input_idx).node;
+}
+
+struct MixNode : ShaderEditorResource::Node {
+	explicit MixNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+	
+	ShaderNodeType getType() const override { return ShaderNodeType::MIX; }
+
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Mix");
+
+		ImGui::BeginGroup();
+		inputSlot(); ImGui::TextUnformatted("A");
+		inputSlot(); ImGui::TextUnformatted("B");
+		inputSlot(); ImGui::TextUnformatted("Weight");
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		outputSlot();
+		return false;
+	}
+#endif
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		const Input input2 = getInput(m_resource, m_id, 2);
+		if (!input0 || !input1 || !input2) {
+			return error("Missing input");
+		}
+		input0.node->generateOnce(blob);
+		input1.node->generateOnce(blob);
+		input2.node->generateOnce(blob);
+		
+		blob << "\t\t" << toPrecision(*this, getOutputType(0)) << toString(getOutputType(0)) << " v" << m_id << " = mix(";
+		input0.printReference(blob);
+		blob << ", ";
+		input1.printReference(blob);
+		blob << ", ";
+		input2.printReference(blob);
+		blob << ");\n";
+		return true;
+	}
+};
+
+// approximate, counts operators and function calls in user's code
+static ShaderEditorResource::Cost estimateCodeCost(const char* code) {
+	static const char* transcendentals[] = { "sin", "cos", "tan", "asin", "acos", "atan", "pow", "exp", "exp2", "log", "log2", "sqrt", "inversesqrt" };
+	ShaderEditorResource::Cost cost;
+	const char* c = code;
+	while (*c) {
+		if (isLetter(*c) || *c == '_') {
+			const char* begin = c;
+			while (isLetter(*c) || isNumeric(*c) || *c == '_') ++c;
+			const StringView name(begin, u32(c - begin));
+			const char* next = c;
+			while (*next == ' ' || *next == '\t') ++next;
+			if (*next != '(') continue;
+			if (startsWith(name, "texture")) {
+				++cost.texture;
+				continue;
+			}
+			bool is_transcendental = false;
+			for (const char* t : transcendentals) is_transcendental = is_transcendental || equalStrings(name, t);
+			if (is_transcendental) ++cost.transcendental;
+			else ++cost.alu;
+			continue;
+		}
+		if (isNumeric(*c)) {
+			// skip literals, so e.g. 1e-3 is not counted as subtraction
+			while (isLetter(*c) || isNumeric(*c) || *c == '.') ++c;
+			continue;
+		}
+		switch (*c) {
+			case '+': case '-': case '*': case '/': case '<': case '>': case '?':
+				++cost.alu;
+				break;
+			default: break;
+		}
+		++c;
+	}
+	return cost;
+}
+
+struct CodeNode : ShaderEditorResource::Node {
+	explicit CodeNode(ShaderEditorResource& resource, IAllocator& allocator)
+		: Node(resource)
+		, m_allocator(allocator)
+		, m_inputs(allocator)
+		, m_outputs(allocator)
+		, m_code(allocator)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::CODE; }
+	// declares named variables
+	bool isPure() const override { return false; }
+
+	ShaderEditorResource::ValueType computeOutputType(int index) const override { return m_outputs[index].type; }
+	u32 getOutputCount() const override { return m_outputs.size(); }
+
+	void serialize(OutputMemoryStream& blob) override {
+		m_resource.writeString(blob, m_code.c_str());
+		blob.write(m_inputs.size());
+		for (const Variable& var : m_inputs) {
+			blob.write(var.type);
+			m_resource.writeString(blob, var.name.c_str());
+		}
+		blob.write(m_outputs.size());
+		for (const Variable& var : m_outputs) {
+			blob.write(var.type);
+			m_resource.writeString(blob, var.name.c_str());
+		}
+	}
+
+	void deserialize(InputMemoryStream& blob) override {
+		m_code = m_resource.readString(blob);
+		i32 size;
+		blob.read(size);
+		for (i32 i = 0; i < size; ++i) {
+			Variable& var = m_inputs.emplace(m_allocator);
+			blob.read(var.type);
+			var.name = m_resource.readString(blob);
+		}
+
+		blob.read(size);
+		for (i32 i = 0; i < size; ++i) {
+			Variable& var = m_outputs.emplace(m_allocator);
+			blob.read(var.type);
+			var.name = m_resource.readString(blob);
+		}
+	}
+
+	bool hasInputPins() const override { return !m_inputs.empty(); }
+	bool hasOutputPins() const override { return !m_outputs.empty(); }
+	ShaderEditorResource::Cost estimateCost() const override { return estimateCodeCost(m_code.c_str()); }
+
+	void fixLinks(u32 deleted_idx, bool is_input) {
+		const ShaderEditorResource::Link* to_del = nullptr;
+		if (is_input) {
+			for (ShaderEditorResource::Link& link : m_resource.m_links) {
+				if (link.getToNode() == m_id) {
+					const u16 to_attr = link.getToPin();
+					if (to_attr == deleted_idx) to_del = &link;
+					else if (to_attr > deleted_idx) {
+						link.to = m_id | (u32(to_attr - 1) << 16);
+					}
+				}
+			}
+		}
+		else {
+			for (ShaderEditorResource::Link& link : m_resource.m_links) {
+				if (link.getFromNode() == m_id) {
+					const u16 from_attr = link.getFromPin();
+					if (from_attr == deleted_idx) to_del = &link;
+					else if (from_attr > deleted_idx) {
+						link.from = m_id | (u32(from_attr - 1) << 16);
+					}
+				}
+			}
+		}
+		if (to_del) m_resource.m_links.erase(u32(to_del - m_resource.m_links.begin()));
+		m_resource.invalidateLinkIndex();
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		bool changed = false;
+		ImGuiEx::NodeTitle("Code");
+
+		ImGui::BeginGroup();
+		for (const Variable& input : m_inputs) {
+			inputSlot();
+			ImGui::TextUnformatted(input.name.c_str());
+		}
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		ImGui::BeginGroup();
+	
+		if (ImGui::Button(ICON_FA_PENCIL_ALT "Edit")) ImGui::OpenPopup("edit");
+
+		if (ImGuiEx::BeginResizablePopup("edit", ImVec2(300, 300))) {
+			auto edit_vars = [&](const char* label, Array<Variable>& vars, bool is_input){
+				if (ImGui::CollapsingHeader(label, ImGuiTreeNodeFlags_DefaultOpen)) {
+					ImGui::PushID(&vars);
+					
+					if (ImGui::BeginTable("tab", 3)) {
+			            ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoResize);
+						ImGui::TableSetupColumn("Type");
+						ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+						ImGui::TableHeadersRow();
+
+						for (Variable& var : vars) {
+							ImGui::PushID(&var);
+							ImGui::TableNextColumn();
+							const u32 idx = u32(&var - vars.begin());
+							bool del = ImGui::Button(ICON_FA_TRASH);
+							ImGui::TableNextColumn();
+							ImGui::SetNextItemWidth(-1);
+							changed = edit("##type", &var.type) || changed;
+							ImGui::TableNextColumn();
+							ImGui::SetNextItemWidth(-1);
+							changed = inputString("##name", &var.name) || changed;
+							ImGui::PopID();
+							if (del) {
+								changed = true;
+								fixLinks(idx, is_input);
+								vars.erase(idx);
+								break;
+							}
+						}
+
+						ImGui::EndTable();
+					}
+
+					if (ImGui::Button("Add")) {
+						vars.emplace(m_allocator);
+						changed = true;
+					}
+					ImGui::PopID();
+				}
+			};
+
+			edit_vars("Inputs", m_inputs, true);
+			edit_vars("Outputs", m_outputs, false);
+
+			if (ImGui::CollapsingHeader("Code", ImGuiTreeNodeFlags_DefaultOpen)) {
+				if (inputStringMultiline("##code", &m_code, ImVec2(-1, ImGui::GetContentRegionAvail().y))) {
+					changed = true;
+				}
+			}
+			ImGui::EndPopup();
+		}
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		ImGui::BeginGroup();
+		for (const Variable& output : m_outputs) {
+			outputSlot();
+			ImGui::TextUnformatted(output.name.c_str());
+		}
+		ImGui::EndGroup();
+
+		return changed;
+	}
+#endif
+
+	bool generate(OutputMemoryStream& blob) override {
+		for (const Variable& input_var : m_inputs) {
+			const u32 idx = u32(&input_var - m_inputs.begin());
+			const Input input = getInput(m_resource, m_id, idx);
+			if (!input) continue;
+
+			input.node->generateOnce(blob);
+			blob << toString(input_var.type) << " " << input_var.name.c_str() << " = ";
+			input.printReference(blob);
+			blob << ";\n";
+		}
+
+		for (const Variable& var : m_outputs) {
+			blob << toString(var.type) << " " << var.name.c_str() << ";";
+		}
+
+		blob << m_code.c_str();
+		return true;
+	}
+	
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		blob << m_outputs[output_idx].name.c_str();
+	}
+
+	struct Variable {
+		Variable(IAllocator& allocator) : name(allocator) {}
+		String name;
+		ShaderEditorResource::ValueType type = ShaderEditorResource::ValueType::FLOAT;
+	};
+
+	IAllocator& m_allocator;
+	Array<Variable> m_inputs;
+	Array<Variable> m_outputs;
+	String m_code;
+};
+
+static u32 getChannelsCount(ShaderEditorResource::ValueType type) {
+	switch (type) {
+		case ShaderEditorResource::ValueType::BOOL:
+		case ShaderEditorResource::ValueType::INT:
+		case ShaderEditorResource::ValueType::FLOAT:
+			return 1;
+		case ShaderEditorResource::ValueType::VEC2:
+			return 2;
+		case ShaderEditorResource::ValueType::VEC3:
+			return 3;
+		case ShaderEditorResource::ValueType::IVEC4:
+		case ShaderEditorResource::ValueType::VEC4:
+			return 4;
+		default:
+			ASSERT(false);
+			return 0;
+	}
+}
+
+// per-component cost of node types, `components` is the channels count of the bigger of the first input and the output
+static ShaderEditorResource::Cost getTypeCost(ShaderNodeType type, u32 components) {
+	ShaderEditorResource::Cost cost;
+	switch (type) {
+		case ShaderNodeType::ADD:
+		case ShaderNodeType::SUBTRACT:
+		case ShaderNodeType::MULTIPLY:
+		case ShaderNodeType::MIN:
+		case ShaderNodeType::MAX:
+		case ShaderNodeType::ABS:
+		case ShaderNodeType::CEIL:
+		case ShaderNodeType::FLOOR:
+		case ShaderNodeType::FRACT:
+		case ShaderNodeType::ROUND:
+		case ShaderNodeType::TRUNC:
+		case ShaderNodeType::SATURATE:
+		case ShaderNodeType::ONEMINUS:
+		case ShaderNodeType::NOT:
+		case ShaderNodeType::ALL:
+		case ShaderNodeType::ANY:
+		case ShaderNodeType::DOT:
+		case ShaderNodeType::IF:
+		case ShaderNodeType::BACKFACE_SWITCH:
+			cost.alu = components;
+			break;
+		case ShaderNodeType::MIX:
+			cost.alu = 2 * components;
+			break;
+		case ShaderNodeType::CROSS:
+			cost.alu = 6;
+			break;
+		// reciprocal is transcendental on most hardware
+		case ShaderNodeType::DIVIDE:
+			cost.alu = components;
+			cost.transcendental = components;
+			break;
+		case ShaderNodeType::LENGTH:
+		case ShaderNodeType::DISTANCE:
+		case ShaderNodeType::NORMALIZE:
+			cost.alu = 2 * components;
+			cost.transcendental = 1;
+			break;
+		case ShaderNodeType::COS:
+		case ShaderNodeType::SIN:
+		case ShaderNodeType::EXP:
+		case ShaderNodeType::EXP2:
+		case ShaderNodeType::LOG:
+		case ShaderNodeType::LOG2:
+		case ShaderNodeType::SQRT:
+			cost.transcendental = components;
+			break;
+		// sin / cos
+		case ShaderNodeType::TAN:
+			cost.transcendental = 2 * components;
+			cost.alu = components;
+			break;
+		// exp2(log2(x) * y)
+		case ShaderNodeType::POW:
+			cost.transcendental = 2 * components;
+			cost.alu = components;
+			break;
+		// dot, one minus, saturate and pow
+		case ShaderNodeType::FRESNEL:
+			cost.alu = 6;
+			cost.transcendental = 2;
+			break;
+		case ShaderNodeType::VIEW_DIR:
+			cost.alu = 6;
+			cost.transcendental = 1;
+			break;
+		case ShaderNodeType::SAMPLE:
+			cost.texture = 1;
+			break;
+		case ShaderNodeType::SCENE_DEPTH:
+			cost.texture = 1;
+			cost.alu = 4;
+			break;
+		case ShaderNodeType::PIXEL_DEPTH:
+		case ShaderNodeType::SCREEN_POSITION:
+			cost.alu = 2;
+			break;
+		// constants, inputs, swizzles and nodes handled by the output node, these usually compile to nothing
+		default: break;
+	}
+	return cost;
+}
+
+static ShaderEditorResource::ValueType pickBiggerType(ShaderEditorResource::ValueType t0, ShaderEditorResource::ValueType t1) {
+	if (getChannelsCount(t0) > getChannelsCount(t1)) return t0;
+	return t1;
+}
+
+static bool isFoldableType(ShaderEditorResource::ValueType type) {
+	switch (type) {
+		case ShaderEditorResource::ValueType::FLOAT:
+		case ShaderEditorResource::ValueType::VEC2:
+		case ShaderEditorResource::ValueType::VEC3:
+		case ShaderEditorResource::ValueType::VEC4:
+			return true;
+		default: return false;
+	}
+}
+
+// scalars are broadcasted to all channels, the same way GLSL does it
+static float getChannel(const ShaderEditorResource::Constant& c, u32 idx) {
+	return getChannelsCount(c.type) == 1 ? c.value[0] : c.value[idx];
+}
+
+static bool isConstant(const ShaderEditorResource::Constant& c, float value) {
+	if (!isFoldableType(c.type)) return false;
+	for (u32 i = 0, count = getChannelsCount(c.type); i < count; ++i) {
+		if (c.value[i] != value) return false;
+	}
+	return true;
+}
+
+// rejects NaNs and infinities, we don't want to print those
+static bool isFinite(const ShaderEditorResource::Constant& c) {
+	for (u32 i = 0, count = getChannelsCount(c.type); i < count; ++i) {
+		const float v = c.value[i];
+		if (v != v || v > 1e30f || v < -1e30f) return false;
+	}
+	return true;
+}
+
+static bool getFoldedInput(const ShaderEditorResource& resource, u16 node_id, u16 input_idx, ShaderEditorResource::Constant& value) {
+	const Input input = getInput(resource, node_id, input_idx);
+	if (!input || !input.node->m_folded) return false;
+	value = input.node->m_constant;
+	return true;
+}
+
+static void printConstant(OutputMemoryStream& blob, const ShaderEditorResource::Constant& c) {
+	const u32 count = getChannelsCount(c.type);
+	if (count == 1) {
+		blob << c.value[0];
+		return;
+	}
+	blob << toString(c.type) << "(";
+	for (u32 i = 0; i < count; ++i) {
+		if (i > 0) blob << ", ";
+		blob << c.value[i];
+	}
+	blob << ")";
+}
+
+void Input::printReference(OutputMemoryStream& blob) const {
+	if (node->m_folded) printConstant(blob, node->m_constant);
+	else if (node->m_interpolated) blob << "v_vs" << node->m_id;
+	else if (node->m_hoisted) blob << "v" << node->m_id;
+	else node->printReference(blob, output_idx);
+}
+
+template <ShaderNodeType Type>
+struct OperatorNode : ShaderEditorResource::Node {
+	explicit OperatorNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return Type; }
+
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override { blob.write(b_val); }
+	bool isInlined() const override { return true; }
+	void deserialize(InputMemoryStream& blob) override { blob.read(b_val); }
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (input0) {
+			const ShaderEditorResource::ValueType type0 = input0.node->getOutputType(input0.output_idx);
+			if (input1) {
+				const ShaderEditorResource::ValueType type1 = input1.node->getOutputType(input1.output_idx);
+				return pickBiggerType(type0, type1);
+			}
+			return type0;
+		}
+		return ShaderEditorResource::ValueType::FLOAT;
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (input0) input0.node->generateOnce(blob);
+		if (input1) input1.node->generateOnce(blob);
+		return true;
+	}
+
+	// B is b_val if it's not connected
+	bool getFoldedB(ShaderEditorResource::Constant& value) const {
+		if (isInputConnected(m_resource, m_id, 1)) return getFoldedInput(m_resource, m_id, 1, value);
+		value.type = ShaderEditorResource::ValueType::FLOAT;
+		value.value[0] = b_val;
+		return true;
+	}
+
+	bool fold(ShaderEditorResource::Constant& result) const override {
+		result.type = getOutputType(0);
+		if (!isFoldableType(result.type)) return false;
+		const u32 channels = getChannelsCount(result.type);
+
+		ShaderEditorResource::Constant a, b;
+		const bool is_a_const = getFoldedInput(m_resource, m_id, 0, a);
+		const bool is_b_const = getFoldedB(b);
+		if (Type == ShaderNodeType::MULTIPLY && ((is_a_const && isConstant(a, 0)) || (is_b_const && isConstant(b, 0)))) {
+			for (u32 i = 0; i < channels; ++i) result.value[i] = 0;
+			return true;
+		}
+		if (!is_a_const || !is_b_const) return false;
+
+		for (u32 i = 0; i < channels; ++i) {
+			const float x = getChannel(a, i);
+			const float y = getChannel(b, i);
+			switch (Type) {
+				case ShaderNodeType::MULTIPLY: result.value[i] = x * y; break;
+				case ShaderNodeType::ADD: result.value[i] = x + y; break;
+				case ShaderNodeType::SUBTRACT: result.value[i] = x - y; break;
+				case ShaderNodeType::DIVIDE: 
+					if (y == 0) return false;
+					result.value[i] = x / y;
+					break;
+				default: ASSERT(false); return false;
+			}
+		}
+		return isFinite(result);
+	}
+
+	bool simplify(ShaderEditorResource::Node*& alias, u16& alias_output) const override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (!input0) return false;
+		const ShaderEditorResource::ValueType type = getOutputType(0);
+
+		ShaderEditorResource::Constant b;
+		const float identity = Type == ShaderNodeType::MULTIPLY || Type == ShaderNodeType::DIVIDE ? 1.f : 0.f;
+		// x * 1, x / 1, x + 0, x - 0
+		if (getFoldedB(b) && isConstant(b, identity) && input0.node->getOutputType(input0.output_idx) == type) {
+			alias = input0.node;
+			alias_output = input0.output_idx;
+			return true;
+		}
+
+		// 1 * x, 0 + x
+		if (Type != ShaderNodeType::MULTIPLY && Type != ShaderNodeType::ADD) return false;
+		ShaderEditorResource::Constant a;
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (input1 && getFoldedInput(m_resource, m_id, 0, a) && isConstant(a, identity) && input1.node->getOutputType(input1.output_idx) == type) {
+			alias = input1.node;
+			alias_output = input1.output_idx;
+			return true;
+		}
+		return false;
+	}
+
+	void printReference(OutputMemoryStream& blob, int attr_idx) const override
+	{
+		const Input input0 = getInput(m_resource, m_id, 0);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (!input0) {
+			blob << "0";
+			return;
+		}
+		
+		blob << "(";
+		input0.printReference(blob);
+		switch(Type) {
+			case ShaderNodeType::MULTIPLY: blob << " * "; break;
+			case ShaderNodeType::ADD: blob << " + "; break;
+			case ShaderNodeType::DIVIDE: blob << " / "; break;
+			case ShaderNodeType::SUBTRACT: blob << " - "; break;
+			default: ASSERT(false); blob << " * "; break;
+		}
+		if (input1) {
+			input1.printReference(blob);
+		}
+		else {
+			blob << b_val;
+		}
+		blob << ")";
+	}
+
+	static const char* getName() {
+		switch (Type) {
+			case ShaderNodeType::ADD: return "Add";
+			case ShaderNodeType::SUBTRACT: return "Subtract";
+			case ShaderNodeType::MULTIPLY: return "Multiply";
+			case ShaderNodeType::DIVIDE: return "Divide";
+			default: 
+				ASSERT(false);
+				return "Error";
+		}
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle(getName());
+
+		outputSlot();
+		inputSlot(); ImGui::Text("A");
+
+		inputSlot();
+		if (isInputConnected(m_resource, m_id, 1)) {
+			ImGui::Text("B");
+		}
+		else {
+			ImGui::DragFloat("B", &b_val);
+		}
+
+		return false;
+	}
+#endif
+
+	float b_val = 2;
+};
+
+struct OneMinusNode : ShaderEditorResource::Node {
+	explicit OneMinusNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::ONEMINUS; }
+	bool isInlined() const override { return true; }
+
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	ShaderEditorResource::ValueType computeOutputType(int index) const override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return ShaderEditorResource::ValueType::FLOAT;
+		return input.node->getOutputType(input.output_idx);
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return error("Missing input");
+		input.node->generateOnce(blob);
+		return true;
+	}
+
+	bool fold(ShaderEditorResource::Constant& result) const override {
+		if (!getFoldedInput(m_resource, m_id, 0, result)) return false;
+		if (!isFoldableType(result.type)) return false;
+		for (u32 i = 0, c = getChannelsCount(result.type); i < c; ++i) result.value[i] = 1 - result.value[i];
+		return true;
+	}
+
+	void printReference(OutputMemoryStream& blob,  int output_idx) const override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return;
+		
+		switch(input.node->getOutputType(input.output_idx)) {
+			default : blob << "(1 - "; break;
+			case ShaderEditorResource::ValueType::VEC4:
+				blob << "(vec4(1) - ";
+				break;
+			case ShaderEditorResource::ValueType::IVEC4:
+				blob << "(ivec4(1) - ";
+				break;
+			case ShaderEditorResource::ValueType::VEC2:
+				blob << "(vec2(1) - ";
+				break;
+			case ShaderEditorResource::ValueType::VEC3:
+				blob << "(vec3(1) - ";
+				break;
+		}
+
+		input.printReference(blob);
+		blob << ")";
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		inputSlot();
+		ImGui::TextUnformatted("1 - X");
+		ImGui::SameLine();
+		outputSlot();
+		return false;
+	}
+#endif
+};
+
+struct SwizzleNode : ShaderEditorResource::Node {
+	explicit SwizzleNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{
+		m_swizzle = "xyzw";
+	}
+	
+	ShaderNodeType getType() const override { return ShaderNodeType::SWIZZLE; }
+	bool isInlined() const override { return true; }
+
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+	
+	void serialize(OutputMemoryStream& blob) override { blob.write(m_swizzle); }
+	void deserialize(InputMemoryStream& blob) override { blob.read(m_swizzle); }
+	ShaderEditorResource::ValueType computeOutputType(int idx) const override { 
+		// TODO other types, e.g. ivec4...
+		switch(stringLength(m_swizzle)) {
+			case 0: return ShaderEditorResource::ValueType::NONE;
+			case 1: return ShaderEditorResource::ValueType::FLOAT;
+			case 2: return ShaderEditorResource::ValueType::VEC2;
+			case 3: return ShaderEditorResource::ValueType::VEC3;
+			case 4: return ShaderEditorResource::ValueType::VEC4;
+			default: ASSERT(false); return ShaderEditorResource::ValueType::NONE;
+		}
+	}
+	
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return error("Missing input");
+		input.node->generateOnce(blob);
+		return true;
+	}
+
+	bool fold(ShaderEditorResource::Constant& result) const override {
+		ShaderEditorResource::Constant input;
+		if (!getFoldedInput(m_resource, m_id, 0, input)) return false;
+		if (!isFoldableType(input.type)) return false;
+
+		result.type = getOutputType(0);
+		if (!isFoldableType(result.type)) return false;
+		const u32 input_channels = getChannelsCount(input.type);
+		for (u32 i = 0, c = getChannelsCount(result.type); i < c; ++i) {
+			u32 channel;
+			switch (m_swizzle.data[i]) {
+				case 'x': case 'r': channel = 0; break;
+				case 'y': case 'g': channel = 1; break;
+				case 'z': case 'b': channel = 2; break;
+				case 'w': case 'a': channel = 3; break;
+				default: return false;
+			}
+			// invalid swizzle, let the shader compiler report it
+			if (channel >= input_channels) return false;
+			result.value[i] = input.value[channel];
+		}
+		return true;
+	}
+
+	void printReference(OutputMemoryStream& blob,  int output_idx) const override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return;
+		
+		input.printReference(blob);
+		blob << "." << m_swizzle;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		inputSlot();
+		ImGui::SetNextItemWidth(50);
+		bool res = ImGui::InputTextWithHint("", "swizzle", m_swizzle.data, sizeof(m_swizzle.data));
+
+		ImGui::SameLine();
+		outputSlot();
+		return res;
+	}
+#endif
+
+	StaticString<5> m_swizzle;
+};
+
+struct FresnelNode : ShaderEditorResource::Node {
+	explicit FresnelNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::FRESNEL; }
+
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream&blob) override {
+		blob.write(F0);
+		blob.write(power);
+	}
+
+	void deserialize(InputMemoryStream&blob) override {
+		blob.read(F0);
+		blob.read(power);
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Fresnel");
+
+		outputSlot();
+		ImGui::DragFloat("F0", &F0);
+		ImGui::DragFloat("Power", &power);
+		return false;
+	}
+#endif
+
+	bool generate(OutputMemoryStream& blob) override {
+		// TODO use data.normal instead of v_normal
+		blob << "\t\t" << toPrecision(*this, ShaderEditorResource::ValueType::FLOAT) << "float v" << m_id << " = mix(" << F0 << ", 1.0, pow(1 - saturate(dot(-normalize(v_wpos.xyz), v_normal)), " << power << "));\n";
+		return true;
+	}
+
+	float F0 = 0.04f;
+	float power = 5.0f;
+};
+
+struct FunctionInputNode : ShaderEditorResource::Node {
+	explicit FunctionInputNode(ShaderEditorResource& resource, IAllocator& allocator)
+		: Node(resource)
+		, m_name(allocator)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::FUNCTION_INPUT; }
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImColor color(ImGui::GetStyle().Colors[ImGuiCol_Tab]);
+		ImGuiEx::BeginNodeTitleBar(color);
+		ImGui::Text("Input %s (%s)", m_name.c_str(), toString(m_type));
+		ImGuiEx::EndNodeTitleBar();
+
+		outputSlot();
+		bool res = inputString("Name", &m_name);
+		res = edit("Type", &m_type) || res;
+		return res;
+	}
+#endif
+
+	void serialize(OutputMemoryStream& blob) override {
+		m_resource.writeString(blob, m_name.c_str());
+		blob.write(m_type);
+	}
+	void deserialize(InputMemoryStream& blob) override {
+		m_name = m_resource.readString(blob);
+		blob.read(m_type);
+	}
+	
+	bool generate(OutputMemoryStream& blob) override { return true; }
+	
+	void printReference(OutputMemoryStream& blob, int attr_idx) const override {
+		blob << m_name.c_str();
+	}
+
+	ShaderEditorResource::ValueType computeOutputType(i32) const override { return m_type; }
+
+	String m_name;
+	ShaderEditorResource::ValueType m_type = ShaderEditorResource::ValueType::FLOAT;
+};
+
+struct FunctionOutputNode : ShaderEditorResource::Node {
+	explicit FunctionOutputNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::FUNCTION_OUTPUT; }
+	bool isPure() const override { return false; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return false; }
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Function output");
+		inputSlot();
+		ImGui::TextUnformatted(" ");
+		return false;
+	}
+#endif
+
+	void serialize(OutputMemoryStream& blob) override {}
+	void deserialize(InputMemoryStream& blob) override {}
+	
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return error("Missing input");
+
+		const ShaderEditorResource::ValueType output_type = input.node->getOutputType(input.output_idx);
+		StringView name = Path::getBasename(m_resource.m_path.c_str());
+		blob << toString(output_type) << " " << name << "(";
+
+		bool first_arg = true;
+		for (const Node* node : m_resource.m_nodes) {
+			if (node->getType() != ShaderNodeType::FUNCTION_INPUT) continue;
+			
+			FunctionInputNode* n = (FunctionInputNode*)node;
+			if (!first_arg) blob << ", ";
+			blob << toString(n->m_type) << " " << n->m_name.c_str();
+			first_arg = false;
+		}
+
+		blob << ") {\n";
+		if (input) {
+			input.node->generateOnce(blob);
+			blob << "\treturn ";
+			input.printReference(blob);
+			blob << ";\n";
+		}
+		blob << "}";
+		return true;
+	}
+};
+
+struct FunctionCallNode : ShaderEditorResource::Node {
+	explicit FunctionCallNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::FUNCTION_CALL; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override { m_resource.writeString(blob, m_function_resource ? m_function_resource->m_path.c_str() : ""); }
+	void deserialize(InputMemoryStream& blob) override {
+		const char* path = m_resource.readString(blob);
+		m_function_resource = m_resource.findFunction(Path(path));
+	}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override {
+		if (!m_function_resource) return ShaderEditorResource::ValueType::FLOAT;
+		return m_function_resource->m_function_output_type;
+	}
+
+	// the whole body of the function, calls are not shared between nodes
+	ShaderEditorResource::Cost estimateCost() const override {
+		ShaderEditorResource::Cost cost;
+		cost.alu = 1;
+		if (!m_function_resource || m_function_resource->m_estimating_cost) return cost;
+		if (!m_function_resource->ensureLoaded()) return cost;
+		m_function_resource->estimateCost();
+		cost.add(m_function_resource->m_cost_estimate.fragment);
+		return cost;
+	}
+	
+	bool generate(OutputMemoryStream& blob) override {
+		if (!m_function_resource) return error("Function not found");
+		StringView fn_name = Path::getBasename(m_function_resource->m_path.c_str());
+		ShaderEditorResource::ValueType type = m_function_resource->m_function_output_type;
+		blob << "\t" << toPrecision(*this, type) << toString(type) << " v" << m_id << " = " << fn_name << "(";
+		const u32 input_count = m_function_resource->m_function_inputs.size();
+		for (u32 i = 0; i < input_count; ++i) {
+			const Input input = getInput(m_resource, m_id, i);
+			if (!input) {
+				return error("Input not connected");
+			}
+			if (i > 0) blob << ", ";
+			input.printReference(blob);
+		}
+		blob << ");\n";
+		return true;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		if (!m_function_resource) {
+			ImGuiEx::NodeTitle("Missing function");
+			outputSlot();
+			inputSlot();
+			return false;
+		}
+		StringView basename = Path::getBasename(m_function_resource->m_path.c_str());
+		StaticString<MAX_PATH> name(basename);
+		ImGuiEx::NodeTitle(name);
+		outputSlot();
+		for (const ShaderEditorResource::FunctionInput& input : m_function_resource->m_function_inputs) {
+			inputSlot();
+			ImGui::TextUnformatted(input.name.c_str());
+		}
+		return false;
+	}
+#endif
+
+	ShaderEditorResource* m_function_resource = nullptr;
+};
+
+template <ShaderNodeType Type>
+struct BuiltinFunctionCallNode : ShaderEditorResource::Node
+{
+	explicit BuiltinFunctionCallNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return Type; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override {}
+	void deserialize(InputMemoryStream& blob) override {}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override { 
+		if constexpr (Type == ShaderNodeType::LENGTH) return ShaderEditorResource::ValueType::FLOAT;
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (input0) return input0.node->getOutputType(input0.output_idx);
+		return ShaderEditorResource::ValueType::FLOAT;
+	}
+
+	static const char* getName() {
+		switch (Type) {
+			case ShaderNodeType::ABS: return "abs";
+			case ShaderNodeType::ALL: return "all";
+			case ShaderNodeType::ANY: return "any";
+			case ShaderNodeType::CEIL: return "ceil";
+			case ShaderNodeType::COS: return "cos";
+			case ShaderNodeType::EXP: return "exp";
+			case ShaderNodeType::EXP2: return "exp2";
+			case ShaderNodeType::FLOOR: return "floor";
+			case ShaderNodeType::FRACT: return "fract";
+			case ShaderNodeType::LENGTH: return "length";
+			case ShaderNodeType::LOG: return "log";
+			case ShaderNodeType::LOG2: return "log2";
+			case ShaderNodeType::NORMALIZE: return "normalize";
+			case ShaderNodeType::NOT: return "not";
+			case ShaderNodeType::ROUND: return "round";
+			case ShaderNodeType::SATURATE: return "saturate";
+			case ShaderNodeType::SIN: return "sin";
+			case ShaderNodeType::SQRT: return "sqrt";
+			case ShaderNodeType::TAN: return "tan";
+			case ShaderNodeType::TRANSPOSE: return "transpose";
+			case ShaderNodeType::TRUNC: return "trunc";
+			default: ASSERT(false); return "error";
+		}
+	}
+
+	bool fold(ShaderEditorResource::Constant& result) const override {
+		ShaderEditorResource::Constant input;
+		if (!getFoldedInput(m_resource, m_id, 0, input)) return false;
+		if (!isFoldableType(input.type)) return false;
+
+		result.type = getOutputType(0);
+		const u32 channels = getChannelsCount(input.type);
+		if (Type == ShaderNodeType::LENGTH || Type == ShaderNodeType::NORMALIZE) {
+			float len2 = 0;
+			for (u32 i = 0; i < channels; ++i) len2 += input.value[i] * input.value[i];
+			const float len = sqrtf(len2);
+			if (Type == ShaderNodeType::LENGTH) {
+				result.value[0] = len;
+				return true;
+			}
+			if (len == 0) return false;
+			for (u32 i = 0; i < channels; ++i) result.value[i] = input.value[i] / len;
+			return true;
+		}
+
+		for (u32 i = 0; i < channels; ++i) {
+			const float x = input.value[i];
+			float& r = result.value[i];
+			switch (Type) {
+				case ShaderNodeType::ABS: r = fabsf(x); break;
+				case ShaderNodeType::CEIL: r = ceilf(x); break;
+				case ShaderNodeType::COS: r = cosf(x); break;
+				case ShaderNodeType::EXP: r = expf(x); break;
+				case ShaderNodeType::EXP2: r = powf(2.f, x); break;
+				case ShaderNodeType::FLOOR: r = floorf(x); break;
+				case ShaderNodeType::FRACT: r = x - floorf(x); break;
+				case ShaderNodeType::LOG:
+					if (x <= 0) return false;
+					r = logf(x);
+					break;
+				case ShaderNodeType::LOG2:
+					if (x <= 0) return false;
+					r = logf(x) / logf(2.f);
+					break;
+				case ShaderNodeType::ROUND: r = floorf(x + 0.5f); break;
+				case ShaderNodeType::SATURATE: r = x < 0 ? 0 : (x > 1 ? 1 : x); break;
+				case ShaderNodeType::SIN: r = sinf(x); break;
+				case ShaderNodeType::SQRT:
+					if (x < 0) return false;
+					r = sqrtf(x);
+					break;
+				case ShaderNodeType::TAN: r = tanf(x); break;
+				case ShaderNodeType::TRUNC: r = x < 0 ? ceilf(x) : floorf(x); break;
+				// bool and matrix functions
+				default: return false;
+			}
+		}
+		return isFinite(result);
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+
+		if (input0) input0.node->generateOnce(blob);
+
+		blob << "\t\t" << toPrecision(*this, getOutputType(0)) << toString(getOutputType(0)) << " v" << m_id << " = " << getName() << "(";
+		if (input0) {
+			input0.printReference(blob);
+		}
+		else {
+			blob << "0";
+		}
+		blob << ");\n";
+		return true;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		inputSlot();
+		ImGui::TextUnformatted(getName());
+		ImGui::SameLine();
+		outputSlot();
+		return false;
+	}
+#endif
+};
+
+static void makeSafeCast(OutputMemoryStream& blob, ShaderEditorResource::ValueType t0, ShaderEditorResource::ValueType t1) {
+	const u32 c0 = getChannelsCount(t0);
+	const u32 c1 = getChannelsCount(t1);
+	if (c0 == c1) return;
+	
+	if (c1 == 1) {
+		blob << ".";
+		for (u32 i = 0; i < c0; ++i) blob << "x";
+	}
+	else if (c0 == 1){
+		blob << ".x";
+	}
+}
+
+struct PowerNode : ShaderEditorResource::Node {
+	explicit PowerNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::POW; }
+
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override {
+		blob.write(m_exponent);
+	}
+
+	void deserialize(InputMemoryStream& blob) override {
+		blob.read(m_exponent);
+	}
+	
+	ShaderEditorResource::ValueType computeOutputType(int) const override { 
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (input0) return input0.node->getOutputType(input0.output_idx);
+		return ShaderEditorResource::ValueType::FLOAT;
+	}
+
+	// exponent is m_exponent if it's not connected
+	bool getFoldedExponent(ShaderEditorResource::Constant& value) const {
+		if (isInputConnected(m_resource, m_id, 1)) return getFoldedInput(m_resource, m_id, 1, value);
+		value.type = ShaderEditorResource::ValueType::FLOAT;
+		value.value[0] = m_exponent;
+		return true;
+	}
+
+	bool fold(ShaderEditorResource::Constant& result) const override {
+		ShaderEditorResource::Constant base, exponent;
+		if (!getFoldedInput(m_resource, m_id, 0, base) || !getFoldedExponent(exponent)) return false;
+		if (!isFoldableType(base.type)) return false;
+
+		result.type = base.type;
+		for (u32 i = 0, c = getChannelsCount(base.type); i < c; ++i) {
+			const float x = base.value[i];
+			// undefined in GLSL
+			if (x < 0) return false;
+			result.value[i] = powf(x, getChannel(exponent, i));
+		}
+		return isFinite(result);
+	}
+
+	bool simplify(ShaderEditorResource::Node*& alias, u16& alias_output) const override {
+		ShaderEditorResource::Constant exponent;
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (!input0 || !getFoldedExponent(exponent) || !isConstant(exponent, 1)) return false;
+		
+		alias = input0.node;
+		alias_output = input0.output_idx;
+		return true;
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (!input0) return error("Missing input");
+		input0.node->generateOnce(blob);
+
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (input1) input1.node->generateOnce(blob);
+
+		const char* type_str = toString(getOutputType(0));
+		blob << "\t\t" << toPrecision(*this, getOutputType(0)) << type_str << " v" << m_id << " = pow(";
+		input0.printReference(blob);
+		blob << ", ";
+		if (input1) {
+			input1.printReference(blob);
+			makeSafeCast(blob
+				, input0.node->getOutputType(input0.output_idx)
+				, input1.node->getOutputType(input1.output_idx));
+		}
+		else {
+			blob << type_str << "(" << m_exponent << ")";
+		}
+		blob << ");\n";
+		return true;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Power");
+		ImGui::BeginGroup();
+		inputSlot(); ImGui::Text("Base");
+		inputSlot(); 
+		if (getInput(m_resource, m_id, 1)) {
+			ImGui::Text("Exponent");
+		}
+		else {
+			ImGui::DragFloat("Exponent", &m_exponent);
+		}
+
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		outputSlot();
+		return false;
+	}
+#endif
+
+	float m_exponent = 2.f;
+};
+
+template <ShaderNodeType Type>
+struct BinaryBuiltinFunctionCallNode : ShaderEditorResource::Node
+{
+	explicit BinaryBuiltinFunctionCallNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{
+	}
+	
+	ShaderNodeType getType() const override { return Type; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override {}
+	void deserialize(InputMemoryStream& blob) override {}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override { 
+		switch (Type) {
+			case ShaderNodeType::DISTANCE:
+			case ShaderNodeType::DOT: return ShaderEditorResource::ValueType::FLOAT;
+			default: break;
+		}
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (input0) return input0.node->getOutputType(input0.output_idx);
+		return ShaderEditorResource::ValueType::FLOAT;
+	}
+
+	static const char* getName() {
+		switch (Type) {
+			case ShaderNodeType::DOT: return "dot";
+			case ShaderNodeType::CROSS: return "cross";
+			case ShaderNodeType::MIN: return "min";
+			case ShaderNodeType::MAX: return "max";
+			case ShaderNodeType::DISTANCE: return "distance";
+			default: ASSERT(false); return "error";
+		}
+	}
+
+	bool fold(ShaderEditorResource::Constant& result) const override {
+		ShaderEditorResource::Constant a, b;
+		if (!getFoldedInput(m_resource, m_id, 0, a) || !getFoldedInput(m_resource, m_id, 1, b)) return false;
+		if (!isFoldableType(a.type) || !isFoldableType(b.type)) return false;
+
+		result.type = getOutputType(0);
+		const u32 channels = getChannelsCount(a.type);
+		switch (Type) {
+			case ShaderNodeType::DOT:
+			case ShaderNodeType::DISTANCE: {
+				float sum = 0;
+				for (u32 i = 0; i < channels; ++i) {
+					const float x = Type == ShaderNodeType::DOT 
+						? a.value[i] * getChannel(b, i)
+						: (a.value[i] - getChannel(b, i)) * (a.value[i] - getChannel(b, i));
+					sum += x;
+				}
+				result.value[0] = Type == ShaderNodeType::DOT ? sum : sqrtf(sum);
+				return true;
+			}
+			case ShaderNodeType::MIN:
+			case ShaderNodeType::MAX:
+				for (u32 i = 0; i < channels; ++i) {
+					const float x = a.value[i];
+					const float y = getChannel(b, i);
+					result.value[i] = (Type == ShaderNodeType::MIN) == (x < y) ? x : y;
+				}
+				return true;
+			case ShaderNodeType::CROSS:
+				if (a.type != ShaderEditorResource::ValueType::VEC3 || b.type != ShaderEditorResource::ValueType::VEC3) return false;
+				result.value[0] = a.value[1] * b.value[2] - a.value[2] * b.value[1];
+				result.value[1] = a.value[2] * b.value[0] - a.value[0] * b.value[2];
+				result.value[2] = a.value[0] * b.value[1] - a.value[1] * b.value[0];
+				return true;
+			default: return false;
+		}
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (input0) input0.node->generateOnce(blob);
+		if (input1) input1.node->generateOnce(blob);
+
+		blob << "\t\t" << toPrecision(*this, getOutputType(0)) << toString(getOutputType(0)) << " v" << m_id << " = " << getName() << "(";
+		if (input0) {
+			input0.printReference(blob);
+		}
+		else {
+			blob << "1";
+		}
+		blob << ", ";
+		if (input1) {
+			input1.printReference(blob);
+			if (input0) {
+				makeSafeCast(blob
+					, input0.node->getOutputType(input0.output_idx)
+					, input1.node->getOutputType(input1.output_idx));
+			}
+		}
+		else {
+			blob << "1";
+		}
+		blob << ");\n";
+		return true;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle(getName());
+		ImGui::BeginGroup();
+		inputSlot(); ImGui::Text("A");
+		inputSlot(); ImGui::Text("B");
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		outputSlot();
+		return false;
+	}
+#endif
+};
+
+struct PositionNode : ShaderEditorResource::Node {
+	explicit PositionNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::POSITION; }
+
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override { blob.write(m_space); }
+	void deserialize(InputMemoryStream& blob) override { blob.read(m_space); }
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override { return ShaderEditorResource::ValueType::VEC3; }
+
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		switch (m_space) {
+			case CAMERA: blob << "v_wpos"; break;
+			case LOCAL: blob << "v_local_position"; break;
+		}
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Position");
+		outputSlot();
+		return ImGui::Combo("Space", (i32*)&m_space, "Camera\0Local\0");
+	}
+#endif
+
+	enum Space : u32 {
+		CAMERA,
+		LOCAL
+	};
+
+	Space m_space = CAMERA;
+};
+
+template <ShaderNodeType Type>
+struct VaryingNode : ShaderEditorResource::Node {
+	explicit VaryingNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return Type; }
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream&) override {}
+	void deserialize(InputMemoryStream&) override {}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override { 
+		switch(Type) {
+			case ShaderNodeType::NORMAL: return ShaderEditorResource::ValueType::VEC3;
+			case ShaderNodeType::UV0: return ShaderEditorResource::ValueType::VEC2;
+			default: ASSERT(false); return ShaderEditorResource::ValueType::VEC3;
+		}
+	}
+
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		switch(Type) {
+			case ShaderNodeType::NORMAL: blob << "v_normal"; break;
+			case ShaderNodeType::UV0: blob << "v_uv"; break;
+			default: ASSERT(false); break;
+		}
+		
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		outputSlot();
+		switch(Type) {
+			case ShaderNodeType::NORMAL: ImGui::Text("Normal"); break;
+			case ShaderNodeType::UV0: ImGui::Text("UV0"); break;
+			default: ASSERT(false); break;
+		}
+		return false;
+	}
+#endif
+};
+
+template <ShaderEditorResource::ValueType TYPE>
+struct ConstNode : ShaderEditorResource::Node
+{
+	explicit ConstNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{
+		m_value[0] = m_value[1] = m_value[2] = m_value[3] = 0;
+		m_int_value = 0;
+	}
+
+	ShaderNodeType getType() const override {
+		switch(TYPE) {
+			case ShaderEditorResource::ValueType::VEC4: return ShaderNodeType::VEC4;
+			case ShaderEditorResource::ValueType::VEC3: return ShaderNodeType::VEC3;
+			case ShaderEditorResource::ValueType::VEC2: return ShaderNodeType::VEC2;
+			case ShaderEditorResource::ValueType::FLOAT: return ShaderNodeType::NUMBER;
+			default: ASSERT(false); return ShaderNodeType::NUMBER;
+		}
+	}
+
+	void serialize(OutputMemoryStream& blob) override
+	{
+		blob.write(m_value);
+		blob.write(m_int_value);
+	}
+
+	void deserialize(InputMemoryStream& blob) override 
+	{
+		blob.read(m_value);
+		blob.read(m_int_value);
+	}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override { return TYPE; }
+	bool isInlined() const override { return true; }
+
+	bool fold(ShaderEditorResource::Constant& result) const override {
+		if (!isFoldableType(TYPE)) return false;
+		result.type = TYPE;
+		for (u32 i = 0, c = getChannelsCount(TYPE); i < c; ++i) {
+			if (!isInputConnected(m_resource, m_id, i)) {
+				result.value[i] = m_value[i];
+				continue;
+			}
+			ShaderEditorResource::Constant input;
+			if (!getFoldedInput(m_resource, m_id, i, input) || getChannelsCount(input.type) != 1) return false;
+			result.value[i] = input.value[0];
+		}
+		return true;
+	}
+
+	void printInputValue(u32 idx, OutputMemoryStream& blob) const {
+		const Input input = getInput(m_resource, m_id, idx);
+		if (input) {
+			input.printReference(blob);
+			return;
+		}
+		blob << m_value[idx];
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		for (u32 i = 0; i < 4; ++i) {
+			const Input input = getInput(m_resource, m_id, i);
+			if (input) input.node->generateOnce(blob);
+		}
+		return true;
+	}
+
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		switch(TYPE) {
+			case ShaderEditorResource::ValueType::VEC4:
+				blob << "vec4(";
+				printInputValue(0, blob);
+				blob << ", "; 
+				printInputValue(1, blob);
+				blob << ", "; 
+				printInputValue(2, blob);
+				blob << ", "; 
+				printInputValue(3, blob);
+				blob << ")";
+				break;
+			case ShaderEditorResource::ValueType::VEC3:
+				blob << "vec3(";
+				printInputValue(0, blob);
+				blob << ", "; 
+				printInputValue(1, blob);
+				blob << ", "; 
+				printInputValue(2, blob);
+				blob << ")";
+				break;
+			case ShaderEditorResource::ValueType::VEC2:
+				blob << "vec2(";
+				printInputValue(0, blob);
+				blob << ", "; 
+				printInputValue(1, blob);
+				blob << ")";
+				break;
+			case ShaderEditorResource::ValueType::INT:
+				blob << m_int_value;
+				break;
+			case ShaderEditorResource::ValueType::FLOAT:
+				blob << m_value[0];
+				break;
+			default: ASSERT(false); break;
+		}
+	}
+	
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		bool res = false;
+
+		const char* labels[] = { "X", "Y", "Z", "W" };
+
+		ImGui::BeginGroup();
+		u32 channels_count = 0;
+		switch (TYPE) {
+			case ShaderEditorResource::ValueType::VEC4: channels_count = 4; break;
+			case ShaderEditorResource::ValueType::VEC3: channels_count = 3; break;
+			case ShaderEditorResource::ValueType::VEC2: channels_count = 2; break;
+			default: channels_count = 1; break;
+		}
+			
+		switch(TYPE) {
+			case ShaderEditorResource::ValueType::VEC4:
+			case ShaderEditorResource::ValueType::VEC3:
+			case ShaderEditorResource::ValueType::VEC2:
+				for (u16 i = 0; i < channels_count; ++i) {
+					inputSlot();
+					if (isInputConnected(m_resource, m_id, i)) {
+						ImGui::TextUnformatted(labels[i]);
+					}
+					else {
+						res = ImGui::DragFloat(labels[i], &m_value[i]);
+					}
+				}
+				switch (TYPE) {
+					case ShaderEditorResource::ValueType::VEC4:
+						res = ImGui::ColorEdit4("##col", m_value, ImGuiColorEditFlags_NoInputs) || res; 
+						break;
+					case ShaderEditorResource::ValueType::VEC3:
+						res = ImGui::ColorEdit3("##col", m_value, ImGuiColorEditFlags_NoInputs) || res; 
+						break;
+					default: break;
+				}
+				break;
+			case ShaderEditorResource::ValueType::FLOAT:
+				ImGui::SetNextItemWidth(60);
+				res = ImGui::DragFloat("##val", m_value) || res;
+				break;
+			case ShaderEditorResource::ValueType::INT:
+				ImGui::SetNextItemWidth(60);
+				res = ImGui::InputInt("##val", &m_int_value) || res;
+				break;
+			default: ASSERT(false); break;
+		}
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		outputSlot();
+
+		return res;
+	}
+#endif
+
+	bool hasInputPins() const override { 
+		switch (TYPE) {
+			case ShaderEditorResource::ValueType::VEC4:
+			case ShaderEditorResource::ValueType::VEC3:
+			case ShaderEditorResource::ValueType::VEC2:
+				return true;
+			default: return false;
+		}
+	}
+
+	bool hasOutputPins() const override { return true; }
+
+	float m_value[4];
+	int m_int_value;
+};
+
+struct SampleNode : ShaderEditorResource::Node
+{
+	explicit SampleNode(ShaderEditorResource& resource, IAllocator& allocator)
+		: Node(resource)
+		, m_texture(allocator)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::SAMPLE; }
+
+
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override { m_resource.writeString(blob, m_texture.c_str()); }
+	void deserialize(InputMemoryStream& blob) override { m_texture = m_resource.readString(blob); }
+	ShaderEditorResource::ValueType computeOutputType(int) const override { return ShaderEditorResource::ValueType::VEC4; }
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (input0) input0.node->generateOnce(blob);
+		const char* texture = m_packed_texture >= 0 ? m_resource.m_packed_textures[m_packed_texture].name.c_str() : m_texture.c_str();
+		char var_name[64];
+		toTextureVarName(Span(var_name), texture);
+		OutputMemoryStream uv(m_resource.m_scratch);
+		if (input0) input0.printReference(uv);
+		else uv << "v_uv";
+
+		// the same texture sampled with the same UV in several places, e.g. to use each channel separately, is fetched once
+		OutputMemoryStream key(m_resource.m_scratch);
+		key << var_name << "|";
+		key.write(uv.data(), uv.size());
+		const u64 hash = StableHash(key.data(), (u32)key.size()).getHashValue();
+		auto iter = m_resource.m_texture_fetches.find(hash);
+		if (iter.isValid()) {
+			m_shared_fetch = iter.value();
+			return true;
+		}
+		m_shared_fetch = nullptr;
+		// variable declared inside a branch can not be shared with code outside of it
+		if (m_resource.m_branch_depth == 0) m_resource.m_texture_fetches.insert(hash, this);
+
+		blob << "\t\t" << toPrecision(*this, ShaderEditorResource::ValueType::VEC4) << "vec4 v" << m_id << " = texture(" << var_name << ", ";
+		blob.write(uv.data(), uv.size());
+		blob << ");\n";
+		return true;
+	}
+
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		blob << "v" << (m_shared_fetch ? m_shared_fetch->m_id : m_id);
+		if (m_packed_texture >= 0) {
+			// consumers swizzle a single channel, so any of them gets the packed one
+			const char swizzle[] = { '.', m_packed_channel, m_packed_channel, m_packed_channel, m_packed_channel, 0 };
+			blob << swizzle;
+		}
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		inputSlot();
+		ImGui::Text("UV");
+
+		ImGui::SameLine();
+		outputSlot();
+		return inputString("Texture", &m_texture);
+	}
+#endif
+
+	String m_texture;
+	// codegen state, node which emitted the same fetch
+	Node* m_shared_fetch = nullptr;
+	// index in ShaderEditorResource::m_packed_textures, -1 if the texture is not packed
+	i32 m_packed_texture = -1;
+	char m_packed_channel = 'x';
+};
+
+struct AppendNode : ShaderEditorResource::Node {
+	explicit AppendNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+	
+	ShaderNodeType getType() const override { return ShaderNodeType::APPEND; }
+	bool isInlined() const override { return true; }
+	
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Append");
+
+		ImGui::BeginGroup();
+		inputSlot();
+		ImGui::TextUnformatted("A");
+		inputSlot();
+		ImGui::TextUnformatted("B");
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		outputSlot();
+		return false;
+	}
+#endif
+
+	static u32 getChannelCount(ShaderEditorResource::ValueType type) {
+		switch (type) {
+			case ShaderEditorResource::ValueType::FLOAT:
+			case ShaderEditorResource::ValueType::BOOL:
+			case ShaderEditorResource::ValueType::INT:
+				return 1;
+			case ShaderEditorResource::ValueType::VEC2:
+				return 2;
+			case ShaderEditorResource::ValueType::VEC3:
+				return 3;
+			case ShaderEditorResource::ValueType::IVEC4:
+			case ShaderEditorResource::ValueType::VEC4:
+				return 4;
+			default:
+				// TODO handle mat3 & co.
+				ASSERT(false);
+				return 1;
+		}
+	}
+
+	ShaderEditorResource::ValueType computeOutputType(int index) const override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		u32 count = 0;
+		if (input0) count += getChannelCount(input0.node->getOutputType(input0.output_idx));
+		if (input1) count += getChannelCount(input1.node->getOutputType(input1.output_idx));
+		// TODO other types likes ivec4
+		switch (count) {
+			case 1: return ShaderEditorResource::ValueType::FLOAT;
+			case 2: return ShaderEditorResource::ValueType::VEC2;
+			case 3: return ShaderEditorResource::ValueType::VEC3;
+			case 4: return ShaderEditorResource::ValueType::VEC4;
+			default: ASSERT(false); return ShaderEditorResource::ValueType::FLOAT;
+		}
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		if (input0) input0.node->generateOnce(blob);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (input1) input1.node->generateOnce(blob);
+		return true;
+	}
+
+	void printReference(OutputMemoryStream& blob,  int output_idx) const override {
+		const Input input0 = getInput(m_resource, m_id, 0);
+		const Input input1 = getInput(m_resource, m_id, 1);
+		if (!input0 && !input1) blob << "0";
+		blob << toString(getOutputType(0)) << "(";
+		if (input0) {
+			input0.printReference(blob);
+			if (input1) blob << ", ";
+		}
+		if (input1) {
+			input1.printReference(blob);
+		}
+		blob << ")";
+	}
+};
+
+struct StaticSwitchNode : ShaderEditorResource::Node {
+	explicit StaticSwitchNode(ShaderEditorResource& resource, IAllocator& allocator)
+		: Node(resource)
+		, m_define(allocator)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::STATIC_SWITCH; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Static switch");
+		
+		ImGui::BeginGroup();
+		inputSlot();
+		ImGui::TextUnformatted("True");
+		inputSlot();
+		ImGui::TextUnformatted("False");
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+		outputSlot();
+		ImGui::SetNextItemWidth(80);
+		return inputString("##param", &m_define);
+	}
+#endif
+
+	void serialize(OutputMemoryStream& blob) override { m_resource.writeString(blob, m_define.c_str()); }
+	void deserialize(InputMemoryStream& blob) override { m_define = m_resource.readString(blob); }
+	
+	const char* getOutputTypeName() const {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return "float";
+		return toString(input.node->getOutputType(input.output_idx));
+	}
+
+	bool generate(OutputMemoryStream& blob) override;
+	
+	ShaderEditorResource::ValueType computeOutputType(int) const override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (input) return input.node->getOutputType(input.output_idx);
+		return ShaderEditorResource::ValueType::FLOAT;
+	}
+
+	// when compiling permutations, the define is known, so the other branch is pruned
+	bool simplify(ShaderEditorResource::Node*& alias, u16& alias_output) const override {
+		if (!m_resource.m_permuting) return false;
+		const i32 define_idx = m_resource.m_permutation_defines.find([&](const String& d) { return d == m_define; });
+		if (define_idx < 0) return false;
+		const bool is_defined = m_resource.m_permutation_mask & (1 << define_idx);
+		const Input input = getInput(m_resource, m_id, is_defined ? 0 : 1);
+		if (!input || input.node->getOutputType(input.output_idx) != getOutputType(0)) return false;
+		alias = input.node;
+		alias_output = input.output_idx;
+		return true;
+	}
+
+	String m_define;
+};
+
+template <ShaderNodeType Type>
+struct ParameterNode : ShaderEditorResource::Node {
+	explicit ParameterNode(ShaderEditorResource& resource, IAllocator& allocator)
+		: Node(resource)
+		, m_name(allocator)
+	{}
+
+	ShaderNodeType getType() const override { return Type; }
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override { m_resource.writeString(blob, m_name.c_str()); }
+	void deserialize(InputMemoryStream& blob) override { m_name = m_resource.readString(blob); }
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		const ImU32 color = ImGui::GetColorU32(ImGuiCol_PlotLinesHovered);
+		switch(Type) {
+			case ShaderNodeType::SCALAR_PARAM: ImGuiEx::NodeTitle("Scalar param", color); break;
+			case ShaderNodeType::VEC4_PARAM: ImGuiEx::NodeTitle("Vec4 param", color); break;
+			case ShaderNodeType::COLOR_PARAM: ImGuiEx::NodeTitle("Color param", color); break;
+			default: ASSERT(false); ImGuiEx::NodeTitle("Error"); break;
+		}
+		
+		outputSlot();
+		return inputString("##name", &m_name);
+	}
+#endif
+
+	// uniform is read directly, copying it to a local does not help
+	bool isInlined() const override { return true; }
+	bool generate(OutputMemoryStream& blob) override { return true; }
+
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		char var_name[64];
+		toUniformVarName(Span(var_name), m_name.c_str());
+		blob << var_name;
+	}
+
+	String m_name;
+};
+
+struct PinNode : ShaderEditorResource::Node {
+	explicit PinNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::PIN; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+	
+	bool generate(OutputMemoryStream& blob) override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (!input) return error("Missing input");
+		input.node->generateOnce(blob);
+		return true;
+	}
+
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		const Input input = getInput(m_resource, m_id, 0);
+		if (input) input.printReference(blob);
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override { 
+		inputSlot();
+		ImGui::TextUnformatted(" ");
+		ImGui::SameLine();
+		outputSlot();
+		return false;
+	}
+#endif
+};
+
+struct PBRNode : ShaderEditorResource::Node
+{
+	explicit PBRNode(ShaderEditorResource& resource)
+		: Node(resource)
+		, m_vertex_decl(gpu::PrimitiveType::TRIANGLE_STRIP)
+		, m_attributes_names(resource.m_node_allocator)
+		, m_packed_streams(resource.m_node_allocator)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::PBR; }
+	bool isPure() const override { return false; }
+
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return false; }
+
+	void serialize(OutputMemoryStream& blob) override {
+		blob.write(m_type);
+		blob.write(m_vertex_decl);
+		blob.write(m_is_masked);
+		blob.write(m_attributes_names.size());
+		for (const String& a : m_attributes_names) {
+			m_resource.writeString(blob, a.c_str());
+		}
+		blob.write(m_auto_vertex_stage);
+		blob.write(m_compile_permutations);
+		blob.write(m_pack_texture_masks);
+		blob.write(m_reduced_precision);
+		blob.write(m_lod_variants);
+		blob.write(m_cost_budget);
+	}
+
+	void deserialize(InputMemoryStream& blob) override {
+		blob.read(m_type);
+		blob.read(m_vertex_decl);
+		blob.read(m_is_masked);
+		u32 c;
+		blob.read(c);
+		m_attributes_names.reserve(c);
+		for (u32 i = 0; i < c; ++i) {
+			m_attributes_names.emplace(m_resource.readString(blob), m_resource.m_node_allocator);
+		}
+		if (m_resource.m_version > Version::VERTEX_STAGE) blob.read(m_auto_vertex_stage);
+		if (m_resource.m_version > Version::PERMUTATIONS) blob.read(m_compile_permutations);
+		if (m_resource.m_version > Version::TEXTURE_PACKING) blob.read(m_pack_texture_masks);
+		if (m_resource.m_version > Version::PRECISION) blob.read(m_reduced_precision);
+		if (m_resource.m_version > Version::LOD_VARIANTS) blob.read(m_lod_variants);
+		if (m_resource.m_version > Version::COST_BUDGET) blob.read(m_cost_budget);
+	}
+
+	static const char* typeToString(const gpu::Attribute& attr) {
+		switch (attr.type) {
+			case gpu::AttributeType::FLOAT:
+				break;
+			case gpu::AttributeType::I16:
+			case gpu::AttributeType::I8:
+				if (attr.flags & gpu::Attribute::AS_INT) {
+					switch (attr.components_count) {
+						case 1: return "int";
+						case 2: return "ivec2";
+						case 3: return "ivec3";
+						case 4: return "ivec4";
+					}
+					ASSERT(false);
+					return "int";
+				}
+				break;
+			case gpu::AttributeType::U8:
+				if (attr.flags & gpu::Attribute::AS_INT) {
+					switch (attr.components_count) {
+						case 1: return "uint";
+						case 2: return "uvec2";
+						case 3: return "uvec3";
+						case 4: return "uvec4";
+					}
+					ASSERT(false);
+					return "int";
+				}
+				break;
+		}
+		switch (attr.components_count) {
+			case 1: return "float";
+			case 2: return "vec2";
+			case 3: return "vec3";
+			case 4: return "vec4";
+		}
+		ASSERT(false);
+		return "float";
+	}
+
+	bool generate(OutputMemoryStream& blob) override;
+	// nodes computed in vertex shader, either set by user or found automatically
+	void findVertexNodes(Array<Node*>& nodes);
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle(m_type == Type::SURFACE ? "PBR Surface" : "PBR Particles");
+
+		bool changed = ImGui::Combo("Type", (i32*)&m_type, "SURFACE\0PARTICLES\0");
+
+		inputSlot(); ImGui::TextUnformatted("Albedo");
+		inputSlot(); ImGui::TextUnformatted("Normal");
+		inputSlot(); ImGui::TextUnformatted("Opacity");
+		inputSlot(); ImGui::TextUnformatted("Roughness");
+		inputSlot(); ImGui::TextUnformatted("Metallic");
+		inputSlot(); ImGui::TextUnformatted("Emission");
+		inputSlot(); ImGui::TextUnformatted("AO");
+		inputSlot(); ImGui::TextUnformatted("Translucency");
+		inputSlot(); ImGui::TextUnformatted("Shadow");
+		inputSlot(); ImGui::TextUnformatted("Position offset");
+
+		changed = ImGui::Checkbox("Masked", &m_is_masked) || changed;
+		if (m_type == Type::SURFACE) {
+			changed = ImGui::Checkbox("Auto vertex hoisting", &m_auto_vertex_stage) || changed;
+			if (ImGui::IsItemHovered()) ImGui::SetTooltip("Move computations linear in vertex attributes to vertex shader");
+		}
+		changed = ImGui::Checkbox("Compile permutations", &m_compile_permutations) || changed;
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("Generate pruned code for each combination of static switches");
+		changed = ImGui::Checkbox("Pack texture masks", &m_pack_texture_masks) || changed;
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("Single channel masks sampled with the same UV are read from one packed texture, see the .packing manifest");
+		changed = ImGui::Checkbox("Reduced precision", &m_reduced_precision) || changed;
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("Color math uses mediump, positions, depth and UVs stay in full precision");
+		changed = ImGui::Checkbox("LOD variants", &m_lod_variants) || changed;
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("LOD-optional nodes are replaced by constants if LOD_REDUCED is defined, use it in materials of lower LODs");
+		ImGui::SetNextItemWidth(80);
+		changed = ImGui::DragInt("Cost budget", (i32*)&m_cost_budget, 1, 0, 100000) || changed;
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("Compilation fails if estimated fragment cost is bigger, 0 means no budget");
+
+		if (m_type == Type::PARTICLES && ImGui::Button("Copy vertex declaration")) {
+			m_show_fs = true;
+		}
+		if (m_type == Type::PARTICLES && !m_resource.m_particle_streams.empty()) {
+			ImGui::SameLine();
+			if (ImGui::Button("Copy reduced declaration")) {
+				OutputMemoryStream manifest(m_resource.m_allocator);
+				m_resource.writeParticleStreamsManifest(manifest);
+				manifest.write('\0');
+				ImGui::SetClipboardText((const char*)manifest.data());
+			}
+			if (ImGui::IsItemHovered()) ImGui::SetTooltip("Streams and components read by the material, the same as in the .particles manifest");
+		}
+
+		FileSelector& fs = m_resource.m_compiler.m_app->getFileSelector();
+		if (fs.gui("Select particle", &m_show_fs, "par", false)) {
+			// TODO emitter index
+			m_vertex_decl = ParticleEditor::getVertexDecl(fs.getPath(), 0, m_attributes_names, *m_resource.m_compiler.m_app);
+			if (m_vertex_decl.attributes_count < 1 || m_vertex_decl.attributes[0].components_count != 3) {
+				logError("First particle shader input must be position (have 3 components)");
+			}
+			changed = true;
+		}
+
+		return changed;
+	}
+#endif
+
+	enum class Type : u32 {
+		SURFACE,
+		PARTICLES
+	};
+
+	static constexpr u32 ALPHA_INPUT = 2;
+	static constexpr u32 POSITION_OFFSET_INPUT = 9;
+	// varyings used by surface_base.inc are below this
+	static constexpr u32 FIRST_VERTEX_STAGE_LOCATION = 12;
+	static constexpr u32 MAX_VERTEX_STAGE_NODES = 4;
+
+	// particle stream read by fragment shader, float streams pass only the read components, packed with other streams in vec4 varyings
+	struct PackedStream {
+		u32 stream;
+		// bit i is set if i-th component is read
+		u8 mask;
+		// index of v_pack<varying>, -1 if the stream has a varying of its own, e.g. integers can not be packed with floats
+		i32 varying;
+		// channel of v_pack<varying> with i-th component of the stream, 0 if the component is not read
+		char channels[4];
+	};
+
+	Array<String> m_attributes_names;
+	// codegen state
+	Array<PackedStream> m_packed_streams;
+	gpu::VertexDecl m_vertex_decl;
+	Type m_type = Type::SURFACE;
+	bool m_show_fs = false;
+	bool m_is_masked = false;
+	bool m_auto_vertex_stage = false;
+	bool m_compile_permutations = false;
+	bool m_pack_texture_masks = false;
+	bool m_reduced_precision = false;
+	bool m_lod_variants = false;
+	u32 m_cost_budget = 0;
+};
+
+struct ParticleStreamNode : ShaderEditorResource::Node {
+	explicit ParticleStreamNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::PARTICLE_STREAM; }
+
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+	
+	void serialize(OutputMemoryStream& blob) override { blob.write(m_stream); }
+	void deserialize(InputMemoryStream& blob) override { blob.read(m_stream); }
+
+	ShaderEditorResource::ValueType computeOutputType(int idx) const override {
+		const Node* n = m_resource.m_nodes[0];
+		ASSERT(n->getType() == ShaderNodeType::PBR);
+		const PBRNode* pbr = (const PBRNode*)n;
+		if (m_stream >= pbr->m_vertex_decl.attributes_count) return ShaderEditorResource::ValueType::FLOAT;
+		return toType(pbr->m_vertex_decl.attributes[m_stream]);
+	}
+
+	bool generate(OutputMemoryStream& blob) override { return true; }
+
+	void printReference(OutputMemoryStream& blob, int output_idx) const override {
+		const Node* n = m_resource.m_nodes[0];
+		ASSERT(n->getType() == ShaderNodeType::PBR);
+		const PBRNode* pbr = (const PBRNode*)n;
+		if (m_stream >= pbr->m_vertex_decl.attributes_count) return;
+		
+		const i32 idx = pbr->m_packed_streams.find([&](const PBRNode::PackedStream& p){ return p.stream == m_stream; });
+		if (idx < 0 || pbr->m_packed_streams[idx].varying < 0) {
+			blob << "v_" << pbr->m_attributes_names[m_stream].c_str();
+			return;
+		}
+
+		// components which are not read are not passed to fragment shader
+		const PBRNode::PackedStream& packed = pbr->m_packed_streams[idx];
+		const u32 count = pbr->m_vertex_decl.attributes[m_stream].components_count;
+		if (count > 1) blob << "vec" << count << "(";
+		for (u32 i = 0; i < count; ++i) {
+			if (i > 0) blob << ", ";
+			const char channel[] = { packed.channels[i], 0 };
+			if (packed.channels[i]) blob << "v_pack" << packed.varying << "." << channel;
+			else blob << "0";
+		}
+		if (count > 1) blob << ")";
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Particle stream");
+		outputSlot();
+		const Node* n = m_resource.m_nodes[0];
+		ASSERT(n->getType() == ShaderNodeType::PBR);
+		const PBRNode* pbr = (const PBRNode*)n;
+		const char* preview = m_stream < (u32)pbr->m_attributes_names.size() ? pbr->m_attributes_names[m_stream].c_str() : "N/A";
+		ImGui::TextUnformatted(preview);
+		return false;
+	}
+#endif
+
+	u32 m_stream = 0;
+};
+
+static bool isInterpolable(ShaderEditorResource::ValueType type) {
+	switch (type) {
+		case ShaderEditorResource::ValueType::FLOAT:
+		case ShaderEditorResource::ValueType::VEC2:
+		case ShaderEditorResource::ValueType::VEC3:
+		case ShaderEditorResource::ValueType::VEC4:
+			return true;
+		default: return false;
+	}
+}
+
+// inputs must have m_frequency already computed
+static ShaderEditorResource::Frequency computeFrequency(const ShaderEditorResource& resource, const ShaderEditorResource::Node& node) {
+	using Frequency = ShaderEditorResource::Frequency;
+	auto input_frequency = [&](u16 idx) {
+		const Input input = getInput(resource, node.m_id, idx);
+		return input ? input.node->m_frequency : Frequency::CONSTANT;
+	};
+	Frequency max_frequency = Frequency::CONSTANT;
+	for (u32 i = 0, c = node.m_input_links.size(); i < c; ++i) {
+		max_frequency = maximum(max_frequency, input_frequency(i));
+	}
+	const Frequency nonlinear = max_frequency == Frequency::LINEAR ? Frequency::VERTEX : max_frequency;
+
+	switch (node.getType()) {
+		case ShaderNodeType::SCALAR_PARAM:
+		case ShaderNodeType::VEC4_PARAM:
+		case ShaderNodeType::COLOR_PARAM:
+		case ShaderNodeType::TIME:
+		case ShaderNodeType::VIEW_DIR:
+			return Frequency::CONSTANT;
+		case ShaderNodeType::UV0:
+		case ShaderNodeType::NORMAL:
+		case ShaderNodeType::POSITION:
+			return Frequency::LINEAR;
+		case ShaderNodeType::VERTEX_ID:
+		case ShaderNodeType::SAMPLE:
+		case ShaderNodeType::PIXEL_DEPTH:
+		case ShaderNodeType::SCENE_DEPTH:
+		case ShaderNodeType::SCREEN_POSITION:
+		case ShaderNodeType::PARTICLE_STREAM:
+		case ShaderNodeType::BACKFACE_SWITCH:
+		case ShaderNodeType::CODE:
+		case ShaderNodeType::FUNCTION_INPUT:
+		case ShaderNodeType::FUNCTION_CALL:
+			return Frequency::FRAGMENT;
+		case ShaderNodeType::FRESNEL:
+			return Frequency::VERTEX;
+		case ShaderNodeType::NUMBER:
+		case ShaderNodeType::VEC2:
+		case ShaderNodeType::VEC3:
+		case ShaderNodeType::VEC4:
+		case ShaderNodeType::ADD:
+		case ShaderNodeType::SUBTRACT:
+		case ShaderNodeType::ONEMINUS:
+		case ShaderNodeType::SWIZZLE:
+		case ShaderNodeType::APPEND:
+		case ShaderNodeType::PIN:
+		case ShaderNodeType::STATIC_SWITCH:
+			return max_frequency;
+		// linear only if scaled by a constant
+		case ShaderNodeType::MULTIPLY:
+			return input_frequency(0) == Frequency::CONSTANT || input_frequency(1) == Frequency::CONSTANT ? max_frequency : nonlinear;
+		case ShaderNodeType::DIVIDE:
+			return input_frequency(1) == Frequency::CONSTANT ? max_frequency : nonlinear;
+		case ShaderNodeType::MIX:
+			return input_frequency(2) == Frequency::CONSTANT ? max_frequency : nonlinear;
+		default:
+			return nonlinear;
+	}
+}
+
+static bool isVertexStageCandidate(ShaderNodeType type) {
+	switch (type) {
+		case ShaderNodeType::ADD:
+		case ShaderNodeType::SUBTRACT:
+		case ShaderNodeType::MULTIPLY:
+		case ShaderNodeType::DIVIDE:
+		case ShaderNodeType::ONEMINUS:
+		case ShaderNodeType::MIX:
+			return true;
+		default: return false;
+	}
+}
+
+void PBRNode::findVertexNodes(Array<Node*>& nodes) {
+	using Frequency = ShaderEditorResource::Frequency;
+	Array<Node*> order(m_resource.m_scratch);
+	m_resource.computeTopologicalOrder(order);
+	for (Node* n : order) {
+		n->m_frequency = n->m_folded ? Frequency::CONSTANT : computeFrequency(m_resource, *n);
+	}
+
+	for (Node* n : order) {
+		if (!n->m_live || !n->m_vertex_stage) continue;
+		if (n->m_frequency == Frequency::FRAGMENT || n->getOutputCount() != 1 || !isInterpolable(n->getOutputType(0))) {
+			n->m_error = "Can not be computed in vertex shader";
+			continue;
+		}
+		if ((u32)nodes.size() == MAX_VERTEX_STAGE_NODES) {
+			n->m_error = "Too many nodes computed in vertex shader";
+			continue;
+		}
+		nodes.push(n);
+	}
+
+	if (!m_auto_vertex_stage) return;
+
+	// roots of linear subgraphs, these are exact after interpolation
+	for (Node* n : order) {
+		if ((u32)nodes.size() == MAX_VERTEX_STAGE_NODES) return;
+		if (!n->m_live || n->m_folded || n->m_vertex_stage) continue;
+		if (n->m_frequency != Frequency::LINEAR || !isVertexStageCandidate(n->getType())) continue;
+		if (n->getOutputCount() != 1 || !isInterpolable(n->getOutputType(0))) continue;
+
+		bool used_in_fragment = false;
+		for (u32 link_idx : n->m_output_links) {
+			const ShaderEditorResource::Link& link = m_resource.m_links[link_idx];
+			Node* to = m_resource.getNode(link.getToNode());
+			if (!to || !to->m_live || to->m_folded) continue;
+			if (to == this) {
+				used_in_fragment = used_in_fragment || link.getToPin() != POSITION_OFFSET_INPUT;
+			}
+			else if (to->m_frequency != Frequency::LINEAR && nodes.indexOf(to) < 0) {
+				used_in_fragment = true;
+			}
+		}
+		if (used_in_fragment) nodes.push(n);
+	}
+}
+
+static u8 getSwizzleMask(const char* swizzle) {
+	u8 mask = 0;
+	for (const char* c = swizzle; *c; ++c) {
+		switch (*c) {
+			case 'x': case 'r': mask |= 1; break;
+			case 'y': case 'g': mask |= 2; break;
+			case 'z': case 'b': mask |= 4; break;
+			case 'w': case 'a': mask |= 8; break;
+		}
+	}
+	return mask;
+}
+
+static u32 countBits(u8 mask) {
+	u32 count = 0;
+	for (; mask; mask &= mask - 1) ++count;
+	return count;
+}
+
+static const char* getComponents(u8 mask) {
+	const char* components[] = { "", "x", "y", "xy", "z", "xz", "yz", "xyz", "w", "xw", "yw", "xyw", "zw", "xzw", "yzw", "xyzw" };
+	return components[mask & 0xf];
+}
+
+bool PBRNode::generate(OutputMemoryStream& blob) {
+	blob << "import \"pipelines/surface_base.inc\"\n\n";
+	
+	// everything here is temporary
+	IAllocator& allocator = m_resource.m_scratch;
+	struct Uniform {
+		Uniform(const char* name, const char* type, u32 size, IAllocator& allocator) : name(name, allocator), type(type), size(size) {}
+		String name;
+		const char* type;
+		u32 size;
+	};
+	Array<Uniform> uniforms(allocator);
+	Array<String> defines(allocator);
+	Array<String> textures(allocator);
+	// components of each particle stream read by any variant
+	Array<u8> stream_masks(allocator);
+	stream_masks.resize(m_type == Type::PARTICLES ? m_vertex_decl.attributes_count : 0);
+	for (u8& mask : stream_masks) mask = 0;
+	Array<ShaderEditorResource*> functions(allocator);
+	
+	auto add_function = [&](FunctionCallNode* n){
+		const i32 idx = functions.indexOf(n->m_function_resource);
+		if (idx < 0) functions.push(n->m_function_resource);
+	};
+
+	// swizzles read only some components, anything else reads all of them
+	auto add_particle_stream_uses = [&](Node* n) {
+		if (n->m_folded) return;
+		for (u32 i = 0, c = n->m_input_links.size(); i < c; ++i) {
+			const Input input = getInput(m_resource, n->m_id, i);
+			if (!input || input.node->getType() != ShaderNodeType::PARTICLE_STREAM) continue;
+			const u32 stream = ((ParticleStreamNode*)input.node)->m_stream;
+			if (stream >= (u32)stream_masks.size()) continue;
+			const u8 all = u8((1 << m_vertex_decl.attributes[stream].components_count) - 1);
+			const u8 mask = n->getType() == ShaderNodeType::SWIZZLE ? getSwizzleMask(((SwizzleNode*)n)->m_swizzle.data) : all;
+			stream_masks[stream] |= mask & all;
+		}
+	};
+
+	// vectors first, so scalars fill whole vec4 slots without padding, sorted by name, so the layout does not depend on node order
+	auto add_uniform = [&](auto* n, const char* type, u32 size) {
+		const i32 idx = uniforms.find([&](const Uniform& u) { return u.name == n->m_name; });
+		if (idx >= 0) return;
+		i32 insert_idx = 0;
+		while (insert_idx < uniforms.size()) {
+			const Uniform& u = uniforms[insert_idx];
+			if (u.size < size || (u.size == size && compareString(u.name.c_str(), n->m_name.c_str()) > 0)) break;
+			++insert_idx;
+		}
+		uniforms.emplaceAt(insert_idx, n->m_name.c_str(), type, size, allocator);
+	};
+	
+	auto add_define = [&](const String& define){
+		const i32 idx = defines.find([&](const String& u) { return u == define; });
+		if (idx < 0) {
+			defines.emplace(define.c_str(), allocator);
+			blob << "define(\"" << define.c_str() << "\")\n";
+		}
+	};
+	
+	m_resource.packTextureMasks();
+	auto add_texture = [&](SampleNode* n){
+		const String& name = n->m_packed_texture >= 0 ? m_resource.m_packed_textures[n->m_packed_texture].name : n->m_texture;
+		const i32 idx = textures.find([&](const String& u) { return u == name; });
+		if (idx < 0) textures.emplace(name.c_str(), allocator);
+	};
+
+	// each permutation of static switches has its own pruned graph, identical ones share a variant
+	// resources (uniforms, textures, ...) are declared once per shader, so we declare those used by any variant
+	const u32 variant_count = m_resource.m_variants.size();
+	const bool has_variants = variant_count > 1;
+	Array<Node*> vertex_nodes(allocator);
+	auto select_variant = [&](u32 variant_idx) {
+		if (has_variants) {
+			m_resource.prepareVariant(variant_idx);
+			m_generated = true;
+		}
+		vertex_nodes.clear();
+		if (m_type == Type::SURFACE) findVertexNodes(vertex_nodes);
+	};
+	auto begin_variant = [&](u32 variant_idx) {
+		select_variant(variant_idx);
+		if (!has_variants) return;
+		blob << (variant_idx == 0 ? "#if " : "#elif ");
+		m_resource.writeVariantCondition(variant_idx, blob);
+		blob << "\n";
+	};
+	auto end_variants = [&]() {
+		if (has_variants) blob << "#endif\n";
+	};
+
+	for (const String& define : m_resource.m_permutation_defines) add_define(define);
+
+	bool has_vertex_code = false;
+	for (u32 variant_idx = 0; variant_idx < variant_count; ++variant_idx) {
+		select_variant(variant_idx);
+		has_vertex_code = has_vertex_code || !vertex_nodes.empty() || getInput(m_resource, m_id, POSITION_OFFSET_INPUT);
+		for (Node* n : m_resource.m_nodes) {
+			if (!n->m_live) continue;
+			if (m_type == Type::PARTICLES) add_particle_stream_uses(n);
+			switch(n->getType()) {
+				case ShaderNodeType::SCALAR_PARAM:
+					add_uniform((ParameterNode<ShaderNodeType::SCALAR_PARAM>*)n, "float", 4);
+					break;
+				case ShaderNodeType::VEC4_PARAM:
+					add_uniform((ParameterNode<ShaderNodeType::VEC4_PARAM>*)n, "vec4", 16);
+					break;
+				case ShaderNodeType::COLOR_PARAM:
+					add_uniform((ParameterNode<ShaderNodeType::COLOR_PARAM>*)n, "color", 16);
+					break;
+				case ShaderNodeType::FUNCTION_CALL:
+					add_function((FunctionCallNode*)n);
+					break;
+				case ShaderNodeType::STATIC_SWITCH:
+					add_define(((StaticSwitchNode*)n)->m_define);
+					break;
+				case ShaderNodeType::SAMPLE:
+					add_texture((SampleNode*)n);
+					break;
+				default: break;
+			}
+		}
+	}
+	// position offset is supported only on surfaces
+	has_vertex_code = has_vertex_code && m_type == Type::SURFACE;
+
+	for (const Uniform& u : uniforms) {
+		blob << "uniform(\"" << u.name.c_str() << "\", \"" << u.type << "\")\n";
+	}
+	
+	// streams with the most read components are packed first, so they are not left without a free varying
+	m_packed_streams.clear();
+	m_resource.m_particle_streams.clear();
+	u32 packed_varyings_count = 0;
+	if (m_type == Type::PARTICLES) {
+		Array<u8> used_channels(allocator);
+		for (u32 count = 4; count > 0; --count) {
+			for (u32 i = 0, c = stream_masks.size(); i < c; ++i) {
+				const u8 mask = stream_masks[i];
+				const bool is_int = m_vertex_decl.attributes[i].flags & gpu::Attribute::AS_INT;
+				if (mask == 0 || (is_int ? count != 4 : countBits(mask) != count)) continue;
+
+				PackedStream packed = {};
+				packed.stream = i;
+				packed.mask = mask;
+				packed.varying = -1;
+				if (is_int) {
+					m_packed_streams.push(packed);
+					continue;
+				}
+				i32 varying = used_channels.find([&](u8 used){ return used + count <= 4; });
+				if (varying < 0) {
+					varying = used_channels.size();
+					used_channels.push(0);
+				}
+				packed.varying = varying;
+				for (u32 j = 0; j < 4; ++j) {
+					if (mask & (1 << j)) packed.channels[j] = "xyzw"[used_channels[varying]++];
+				}
+				m_packed_streams.push(packed);
+			}
+		}
+		packed_varyings_count = used_channels.size();
+
+		// particle system can skip upload of streams which are not here, see writeParticleStreamsManifest
+		for (u32 i = 0, c = stream_masks.size(); i < c; ++i) {
+			if (i != 0 && stream_masks[i] == 0) continue;
+			ShaderEditorResource::ParticleStream& stream = m_resource.m_particle_streams.emplace(m_resource.m_allocator);
+			stream.name = m_attributes_names[i];
+			stream.stream = i;
+			// vertex shader reads whole position
+			stream.mask = i == 0 ? u8((1 << m_vertex_decl.attributes[0].components_count) - 1) : stream_masks[i];
+		}
+
+		blob << "common(\"#define PARTICLES\\n\")\n";
+		blob << "-- particle streams read by the material:";
+		for (const ShaderEditorResource::ParticleStream& stream : m_resource.m_particle_streams) {
+			blob << " " << stream.name.c_str() << "." << getComponents(stream.mask);
+		}
+		blob << "\n";
+	}
+
+	auto write_functions = [&]() {
+		return m_resource.m_compiler.writeFunctions(functions, blob);
+	};
+
+	auto write_varyings = [&](const char* qualifier) {
+		for (u32 variant_idx = 0; variant_idx < variant_count; ++variant_idx) {
+			begin_variant(variant_idx);
+			for (Node* n : vertex_nodes) {
+				const u32 location = FIRST_VERTEX_STAGE_LOCATION + vertex_nodes.indexOf(n);
+				blob << "\tlayout(location = " << location << ") " << qualifier << " " << toString(n->getOutputType(0)) << " v_vs" << n->m_id << ";\n";
+			}
+		}
+		end_variants();
+	};
+
+	blob << "surface_shader_ex({\n";
+	blob << "texture_slots = {\n";
+	for (const String& texture : textures) {
+		blob << "{\n"
+			<< "\tname = \"" << texture.c_str() << "\",\n"
+			<< "\tdefault_texture = \"textures/common/white.tga\"\n"
+			<< "}\n";
+	}
+	blob << "},\n";
+	
+	if (m_type == Type::PARTICLES && !m_attributes_names.empty()) {
+		auto write_particle_varyings = [&](const char* qualifier) {
+			for (u32 i = 0; i < packed_varyings_count; ++i) {
+				blob << "\tlayout(location = " << i + 1 << ") " << qualifier << " vec4 v_pack" << i << ";\n";
+			}
+			u32 location = packed_varyings_count + 1;
+			for (const PackedStream& packed : m_packed_streams) {
+				if (packed.varying >= 0) continue;
+				blob << "\tlayout(location = " << location << ") " << qualifier << " " << typeToString(m_vertex_decl.attributes[packed.stream]) << " v_" << m_attributes_names[packed.stream].c_str() << ";\n";
+				++location;
+			}
+		};
+
+		blob << "vertex_preface = [[\n";
+		for (u32 i = 0, c = stream_masks.size(); i < c; ++i) {
+			if (i != 0 && stream_masks[i] == 0) continue;
+			blob << "\tlayout(location = " << i << ") in " << typeToString(m_vertex_decl.attributes[i]) << " i_" << m_attributes_names[i].c_str() << ";\n";
+		}
+		write_particle_varyings("out");
+		blob << R"#(
+				layout (location = 0) out vec2 v_uv;
+			]],
+			vertex = [[
+				vec2 pos = vec2(gl_VertexID & 1, (gl_VertexID & 2) * 0.5);
+				v_uv = pos;
+		)#";
+		for (u32 i = 0; i < packed_varyings_count; ++i) {
+			blob << "\t\tv_pack" << i << " = vec4(0);\n";
+		}
+		for (const PackedStream& packed : m_packed_streams) {
+			const char* name = m_attributes_names[packed.stream].c_str();
+			if (packed.varying < 0) {
+				blob << "\t\tv_" << name << " = i_" << name << ";\n";
+				continue;
+			}
+			char dst[5] = {};
+			char src[5] = {};
+			u32 count = 0;
+			for (u32 j = 0; j < 4; ++j) {
+				if (!packed.channels[j]) continue;
+				dst[count] = packed.channels[j];
+				src[count] = "xyzw"[j];
+				++count;
+			}
+			blob << "\t\tv_pack" << packed.varying << "." << dst << " = i_" << name;
+			// swizzling a scalar is not allowed
+			if (m_vertex_decl.attributes[packed.stream].components_count > 1) blob << "." << src;
+			blob << ";\n";
+		}
+		blob << R"#(
+				pos = pos * 2 - 1;
+				gl_Position = Pass.projection * ((Pass.view * u_model * vec4(i_)#" << m_attributes_names[0].c_str() << R"#(.xyz, 1)) + vec4(pos.xy, 0, 0));
+			]],
+
+			fragment_preface = [[
+			)#";
+		if (!write_functions()) return false;
+		write_particle_varyings("in");
+		blob << R"#(
+				layout (location = 0) in vec2 v_uv;
+			]],
+		)#";
+	}
+	else {
+		if (has_vertex_code) {
+			blob << "vertex_preface = [[\n";
+			if (!write_functions()) return false;
+			write_varyings("out");
+			blob << "]],\n\n";
+		}
+		blob << "fragment_preface = [[\n";
+		if (!write_functions()) return false;
+		write_varyings("in");
+		blob << "]],\n\n";
+	}
+
+
+	blob << "fragment = [[\n";
+	
+	bool need_local_position = false;
+	for (Node* n : m_resource.m_nodes) {
+		if (n->getType() == ShaderNodeType::POSITION) {
+			need_local_position = need_local_position || ((PositionNode*)n)->m_space == PositionNode::LOCAL;
+		}
+	}
+
+	const struct {
+		const char* name;
+		const char* default_value;
+		const char* particle_default = nullptr;
+	}
+	fields[] = { 
+		{ "albedo", "vec3(1, 0, 1)" },
+		{ "N", "v_normal", "vec3(0, 1, 0)" },
+		{ "alpha", "1" }, 
+		{ "roughness", "1" },
+		{ "metallic", "0" },
+		{ "emission", "0" },
+		{ "ao", "1" },
+		{ "translucency", "0" },
+		{ "shadow", "1" }
+	};
+
+	// masked materials compute alpha first, so discarded pixels skip the rest, nodes shared with alpha are generated only once
+	auto field_order = [&](u32 idx) -> u32 {
+		if (!m_is_masked || idx > ALPHA_INPUT) return idx;
+		return idx == 0 ? ALPHA_INPUT : idx - 1;
+	};
+
+	for (u32 variant_idx = 0; variant_idx < variant_count; ++variant_idx) {
+		begin_variant(variant_idx);
+		for (Node* n : m_resource.m_nodes) n->m_generated = false;
+		for (Node* n : vertex_nodes) n->m_interpolated = true;
+		m_resource.m_texture_fetches.clear();
+
+		for (u32 field_idx = 0; field_idx < lengthOf(fields); ++field_idx) {
+			const int i = field_order(field_idx);
+			const auto& field = fields[i];
+			Input input = getInput(m_resource, m_id, i);
+			if (input && !input.node->m_lod_dropped) {
+				input.node->generateOnce(blob);
+				blob << "\tdata." << field.name << " = ";
+				if (i < 2) blob << "vec3(";
+				input.printReference(blob);
+				const ShaderEditorResource::ValueType type = input.node->getOutputType(input.output_idx);
+				if (i == 0) {
+					switch(type) {
+						case ShaderEditorResource::ValueType::IVEC4:
+						case ShaderEditorResource::ValueType::VEC4:
+							blob << ".rgb"; break;
+						case ShaderEditorResource::ValueType::VEC3:
+							break;
+						case ShaderEditorResource::ValueType::VEC2:
+							blob << ".rgr"; break;
+						case ShaderEditorResource::ValueType::BOOL:
+						case ShaderEditorResource::ValueType::INT:
+						case ShaderEditorResource::ValueType::FLOAT:
+							break;
+						case ShaderEditorResource::ValueType::COUNT:
+						case ShaderEditorResource::ValueType::NONE:
+							// invalid data
+							break;
+					}
+				}
+				else if (type != ShaderEditorResource::ValueType::VEC3 && i < 2) blob << ".rgb";
+				else if (type != ShaderEditorResource::ValueType::FLOAT && i >= 2) blob << ".x";
+				if (i < 2) blob << ")";
+				blob << ";\n";
+			}
+			else {
+				if (m_type == Type::PARTICLES && field.particle_default) {
+					blob << "\tdata." << field.name << " = " << field.particle_default << ";\n";
+				}
+				else {
+					blob << "\tdata." << field.name << " = " << field.default_value << ";\n";
+				}
+			}
+			if (m_is_masked && i == ALPHA_INPUT) blob << "\tif (data.alpha < 0.5) discard;\n";
+		}
+	}
+	end_variants();
+
+	blob << "\tdata.V = vec3(0);\n";
+	blob << "\tdata.wpos = vec3(0);\n";
+	blob << "]]\n";
+	if (has_vertex_code) {
+		blob << ", vertex = [[\n";
+		for (u32 variant_idx = 0; variant_idx < variant_count; ++variant_idx) {
+			begin_variant(variant_idx);
+			// nodes used in both stages must be generated again, variables from fragment shader do not exist here
+			for (Node* n : m_resource.m_nodes) {
+				n->m_generated = false;
+				n->m_hoisted = false;
+				n->m_interpolated = false;
+			}
+			m_resource.m_texture_fetches.clear();
+			m_generated = true;
+			for (Node* n : vertex_nodes) {
+				if (!n->generateOnce(blob)) return false;
+				blob << "\tv_vs" << n->m_id << " = ";
+				Input{n, 0}.printReference(blob);
+				blob << ";\n";
+			}
+			const Input po_input = getInput(m_resource, m_id, POSITION_OFFSET_INPUT);
+			if (po_input) {
+				if (!po_input.node->generateOnce(blob)) return false;
+				blob << "\tv_wpos += ";
+				po_input.printReference(blob);
+				blob << ";\n";
+			}
+		}
+		end_variants();
+		blob << "]]\n";
+	}
+
+	if (need_local_position) blob << ",\nneed_local_position = true\n";
+	blob << "})\n";
+	return true;
+}
+
+enum class BranchLowering : u8 {
+	// SELECT if all sides are cheap, BRANCH otherwise
+	AUTO,
+	// only the taken side is computed
+	BRANCH,
+	// all sides are computed, result is selected without divergent control flow
+	SELECT
+};
+
+// sides cheaper than this are computed unconditionally in AUTO mode, it's e.g. two texture fetches or a handful of ALU ops
+static constexpr u32 AUTO_SELECT_MAX_COST = 16;
+
+// nodes of a branch are generated inside it, so the rest of the graph must be generated before the branch is opened
+struct BranchSide {
+	BranchSide(IAllocator& allocator) : nodes(allocator) {}
+
+	void collect(const ShaderEditorResource& resource, const ShaderEditorResource::Node& node, u16 pin, bool is_uniform) {
+		uniform = is_uniform;
+		input = getInput(resource, node.m_id, pin);
+		if (input) resource.collectBranchNodes(node, pin, uniform, nodes);
+	}
+
+	u32 getCost() const {
+		u32 cost = 0;
+		for (const ShaderEditorResource::Node* n : nodes) cost += n->estimateCost().getWeighted();
+		return cost;
+	}
+
+	// expression of an inlined node is evaluated where it's printed, i.e. possibly inside the branch
+	static bool hasInlinedDerivatives(const ShaderEditorResource& resource, const ShaderEditorResource::Node& node) {
+		if (!node.isInlined() || node.m_hoisted || node.m_folded || node.m_interpolated) return false;
+		if (node.estimateCost().texture > 0) return true;
+		for (u32 i = 0, c = node.m_input_links.size(); i < c; ++i) {
+			const Input input = getInput(resource, node.m_id, i);
+			if (input && hasInlinedDerivatives(resource, *input.node)) return true;
+		}
+		return false;
+	}
+
+	void generateOutside(const ShaderEditorResource& resource, ShaderEditorResource::Node& node, OutputMemoryStream& blob) const {
+		node.generateOnce(blob);
+		if (uniform || node.getOutputCount() != 1 || !hasInlinedDerivatives(resource, node)) return;
+		const ShaderEditorResource::ValueType type = node.getOutputType(0);
+		blob << "\t\t" << toPrecision(node, type) << toString(type) << " v" << node.m_id << " = ";
+		node.printReference(blob, 0);
+		blob << ";\n";
+		node.m_hoisted = true;
+	}
+
+	void generateDependencies(const ShaderEditorResource& resource, OutputMemoryStream& blob) const {
+		if (!input) return;
+		if (nodes.indexOf(input.node) < 0) {
+			generateOutside(resource, *input.node, blob);
+			return;
+		}
+		for (ShaderEditorResource::Node* n : nodes) {
+			if (n->m_folded) continue;
+			for (u32 i = 0, c = n->m_input_links.size(); i < c; ++i) {
+				const Input dep = getInput(resource, n->m_id, i);
+				if (dep && nodes.indexOf(dep.node) < 0) generateOutside(resource, *dep.node, blob);
+			}
+		}
+	}
+
+	// inside the opened branch
+	void generate(ShaderEditorResource& resource, OutputMemoryStream& blob) const {
+		++resource.m_branch_depth;
+		input.node->generateOnce(blob);
+		--resource.m_branch_depth;
+	}
+
+	Input input;
+	Array<ShaderEditorResource::Node*> nodes;
+	bool uniform = false;
+};
+
+// each #ifdef arm is a branch, code used by both arms or after #endif must be generated before #ifdef
+bool StaticSwitchNode::generate(OutputMemoryStream& blob) {
+	IAllocator& allocator = m_resource.m_scratch;
+	BranchSide sides[] = { BranchSide(allocator), BranchSide(allocator) };
+	sides[0].collect(m_resource, *this, 0, true);
+	sides[1].collect(m_resource, *this, 1, true);
+	for (const BranchSide& side : sides) side.generateDependencies(m_resource, blob);
+
+	auto generate_arm = [&](const BranchSide& side) {
+		if (!side.input) return;
+		side.generate(m_resource, blob);
+		blob << getOutputTypeName() << " v" << m_id << " = ";
+		side.input.printReference(blob);
+		blob << ";\n";
+	};
+	blob << "#ifdef " << m_define.c_str() << "\n";
+	generate_arm(sides[0]);
+	blob << "#else\n";
+	generate_arm(sides[1]);
+	blob << "#endif\n";
+	return true;
+}
+
+static bool shouldSelect(BranchLowering lowering, const BranchSide* sides, u32 count) {
+	switch (lowering) {
+		case BranchLowering::BRANCH: return false;
+		case BranchLowering::SELECT: return true;
+		case BranchLowering::AUTO: break;
+	}
+	for (u32 i = 0; i < count; ++i) {
+		if (sides[i].getCost() > AUTO_SELECT_MAX_COST) return false;
+	}
+	return true;
+}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+static bool loweringGUI(BranchLowering& lowering) {
+	i32 value = (i32)lowering;
+	ImGui::SetNextItemWidth(80);
+	if (!ImGui::Combo("Lowering", &value, "Auto\0Branch\0Select\0")) return false;
+	lowering = (BranchLowering)value;
+	return true;
+}
+#endif
+
+struct BackfaceSwitchNode : ShaderEditorResource::Node {
+	explicit BackfaceSwitchNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::BACKFACE_SWITCH; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override { blob.write(m_lowering); }
+	void deserialize(InputMemoryStream& blob) override {
+		if (m_resource.m_version > Version::BRANCH_LOWERING) blob.read(m_lowering);
+	}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override {
+		const Input inputA = getInput(m_resource, m_id, 0);
+		if (inputA) {
+			return inputA.node->getOutputType(inputA.output_idx);
+		}
+		const Input inputB = getInput(m_resource, m_id, 1);
+		if (inputB) {
+			return inputB.node->getOutputType(inputB.output_idx);
+		}
+		return ShaderEditorResource::ValueType::FLOAT;
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		IAllocator& allocator = m_resource.m_scratch;
+		BranchSide sides[] = { BranchSide(allocator), BranchSide(allocator) };
+		sides[0].collect(m_resource, *this, 0, false);
+		sides[1].collect(m_resource, *this, 1, false);
+		if (!sides[0].input && !sides[1].input) return error("Missing inputs");
+
+		const char* type = toString(getOutputType(0));
+		const char* precision = toPrecision(*this, getOutputType(0));
+		// value of a missing side is undefined, so we can use the other one
+		if (!sides[0].input || !sides[1].input || shouldSelect(m_lowering, sides, lengthOf(sides))) {
+			const Input front = sides[0].input ? sides[0].input : sides[1].input;
+			const Input back = sides[1].input ? sides[1].input : sides[0].input;
+			front.node->generateOnce(blob);
+			back.node->generateOnce(blob);
+			blob << "\t\t" << precision << type << " v" << m_id << " = ";
+			if (sides[0].input && sides[1].input) {
+				blob << "gl_FrontFacing ? ";
+				front.printReference(blob);
+				blob << " : ";
+			}
+			back.printReference(blob);
+			blob << ";\n";
+			return true;
+		}
+
+		for (const BranchSide& side : sides) side.generateDependencies(m_resource, blob);
+		blob << "\t\t" << precision << type << " v" << m_id << ";\n";
+		blob << "\t\tif (gl_FrontFacing) {\n";
+		sides[0].generate(m_resource, blob);
+		blob << "\t\t\tv" << m_id << " = ";
+		sides[0].input.printReference(blob);
+		blob << ";\n\t\t}\n\t\telse {\n";
+		sides[1].generate(m_resource, blob);
+		blob << "\t\t\tv" << m_id << " = ";
+		sides[1].input.printReference(blob);
+		blob << ";\n\t\t}\n";
+		return true;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGuiEx::NodeTitle("Backface switch");
+		outputSlot();
+		inputSlot(); ImGui::TextUnformatted("Front");
+		inputSlot(); ImGui::TextUnformatted("Back");
+		return loweringGUI(m_lowering);
+	}
+#endif
+
+	BranchLowering m_lowering = BranchLowering::AUTO;
+};
+
+struct IfNode : ShaderEditorResource::Node {
+	explicit IfNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::IF; }
+	bool hasInputPins() const override { return true; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override { blob.write(m_lowering); }
+	void deserialize(InputMemoryStream& blob) override {
+		if (m_resource.m_version > Version::BRANCH_LOWERING) blob.read(m_lowering);
+	}
+
+	bool generate(OutputMemoryStream& blob) override {
+		const Input inputA = getInput(m_resource, m_id, 0);
+		const Input inputB = getInput(m_resource, m_id, 1);
+		if (!inputA || !inputB) return error("Missing input");
+
+		// GT, EQ, LT
+		IAllocator& allocator = m_resource.m_scratch;
+		BranchSide sides[] = { BranchSide(allocator), BranchSide(allocator), BranchSide(allocator) };
+		const char* operators[] = { " > ", " == ", " < " };
+		BranchSide* present[3];
+		const char* present_operators[3];
+		u32 present_count = 0;
+		for (u32 i = 0; i < lengthOf(sides); ++i) {
+			sides[i].collect(m_resource, *this, 2 + i, false);
+			if (!sides[i].input) continue;
+			present[present_count] = &sides[i];
+			present_operators[present_count] = operators[i];
+			++present_count;
+		}
+		if (present_count == 0) return error("Missing input");
+
+		inputA.node->generateOnce(blob);
+		inputB.node->generateOnce(blob);
+
+		auto write_condition = [&](const char* op) {
+			inputA.printReference(blob);
+			blob << op;
+			inputB.printReference(blob);
+		};
+
+		const char* type = toString(getOutputType(0));
+		const char* precision = toPrecision(*this, getOutputType(0));
+		if (shouldSelect(m_lowering, sides, lengthOf(sides))) {
+			// value is undefined if no condition is true, so the last present side does not need its condition
+			for (u32 i = 0; i < present_count; ++i) present[i]->input.node->generateOnce(blob);
+			blob << "\t\t" << precision << type << " v" << m_id << " = ";
+			for (u32 i = 0; i + 1 < present_count; ++i) {
+				blob << "(";
+				write_condition(present_operators[i]);
+				blob << ") ? ";
+				present[i]->input.printReference(blob);
+				blob << " : ";
+			}
+			present[present_count - 1]->input.printReference(blob);
+			blob << ";\n";
+			return true;
+		}
+
+		for (u32 i = 0; i < present_count; ++i) present[i]->generateDependencies(m_resource, blob);
+		blob << "\t\t" << precision << type << " v" << m_id << ";\n";
+		for (u32 i = 0; i < present_count; ++i) {
+			blob << (i == 0 ? "\t\tif (" : "\t\telse if (");
+			write_condition(present_operators[i]);
+			blob << ") {\n";
+			present[i]->generate(m_resource, blob);
+			blob << "\t\t\tv" << m_id << " = ";
+			present[i]->input.printReference(blob);
+			blob << ";\n";
+			blob << "\t\t}\n";
+		}
+		return true;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		ImGui::BeginGroup();
+		inputSlot();
+		ImGui::Text("A");
+		
+		inputSlot();
+		ImGui::Text("B");
+
+		inputSlot();
+		ImGui::Text("A > B");
+
+		inputSlot();
+		ImGui::Text("A == B");
+
+		inputSlot();
+		ImGui::Text("A < B");
+		ImGui::EndGroup();
+
+		ImGui::SameLine();
+
+		ImGui::BeginGroup();
+		outputSlot();
+		ImGui::TextUnformatted("Output");
+		const bool res = loweringGUI(m_lowering);
+		ImGui::EndGroup();
+
+		return res;
+	}
+#endif
+
+	BranchLowering m_lowering = BranchLowering::AUTO;
+};
+
+struct VertexIDNode : ShaderEditorResource::Node
+{
+	explicit VertexIDNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return ShaderNodeType::VERTEX_ID; }
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override {}
+	void deserialize(InputMemoryStream& blob) override {}
+
+	void printReference(OutputMemoryStream& blob,  int output_idx) const override {
+		blob << "gl_VertexID";
+	}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override
+	{
+		return ShaderEditorResource::ValueType::INT;
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override {
+		outputSlot();
+		ImGui::Text("Vertex ID");
+		return false;
+	}
+#endif
+};
+
+template <ShaderNodeType Type>
+struct UniformNode : ShaderEditorResource::Node
+{
+	explicit UniformNode(ShaderEditorResource& resource)
+		: Node(resource)
+	{}
+
+	ShaderNodeType getType() const override { return Type; }
+	bool hasInputPins() const override { return false; }
+	bool hasOutputPins() const override { return true; }
+
+	void serialize(OutputMemoryStream& blob) override {}
+	void deserialize(InputMemoryStream& blob) override {}
+
+	void printReference(OutputMemoryStream& blob,  int output_idx) const override
+	{
+		blob << getVarName();
+	}
+
+	ShaderEditorResource::ValueType computeOutputType(int) const override
+	{
+		switch (Type) {
+			case ShaderNodeType::SCREEN_POSITION: return ShaderEditorResource::ValueType::VEC2;
+			case ShaderNodeType::VIEW_DIR: return ShaderEditorResource::ValueType::VEC3;
+			case ShaderNodeType::SCENE_DEPTH:
+			case ShaderNodeType::PIXEL_DEPTH:
+			case ShaderNodeType::TIME:
+				return ShaderEditorResource::ValueType::FLOAT;
+			default: 
+				ASSERT(false);
+				return ShaderEditorResource::ValueType::FLOAT;
+		}
+	}
+
+	static const char* getVarName() {
+		switch (Type) {
+			case ShaderNodeType::TIME: return "Global.time";
+			case ShaderNodeType::VIEW_DIR: return "Pass.view_dir.xyz";
+			case ShaderNodeType::PIXEL_DEPTH: return "toLinearDepth(Pass.inv_projection, gl_FragCoord.z)";
+			case ShaderNodeType::SCENE_DEPTH: return "toLinearDepth(Pass.inv_projection, texture(u_depthbuffer, gl_FragCoord.xy / Global.framebuffer_size).x)";
+			case ShaderNodeType::SCREEN_POSITION: return "(gl_FragCoord.xy / Global.framebuffer_size)";
+			default: ASSERT(false); return "Error";
+		}
+	}
+
+	static const char* getName() {
+		switch (Type) {
+			case ShaderNodeType::TIME: return "Time";
+			case ShaderNodeType::VIEW_DIR: return "View direction";
+			case ShaderNodeType::PIXEL_DEPTH: return "Pixel depth";
+			case ShaderNodeType::SCENE_DEPTH: return "Scene depth";
+			case ShaderNodeType::SCREEN_POSITION: return "Screen position";
+			default: ASSERT(false); return "Error";
+		}
+	}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	bool onGUI() override
+	{
+		outputSlot();
+		ImGui::TextUnformatted(getName());
+		return false;
+	}
+#endif
+};
+
+static bool isConstantNode(ShaderNodeType type) {
+	switch (type) {
+		case ShaderNodeType::NUMBER:
+		case ShaderNodeType::VEC2:
+		case ShaderNodeType::VEC3:
+		case ShaderNodeType::VEC4:
+			return true;
+		default: return false;
+	}
+}
+
+} // anonymous namespace
+
+ShaderEditorResource::Node::Node(ShaderEditorResource& resource)
+	: m_resource(resource)
+	, m_error(resource.m_node_allocator)
+	, m_input_links(resource.m_node_allocator)
+	, m_output_links(resource.m_node_allocator)
+	, m_output_types(resource.m_node_allocator)
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	, m_cached_pins(resource.m_node_allocator)
+#endif
+{
+	m_id = 0xffFF;
+}
+
+void ShaderEditorResource::Node::printReference(OutputMemoryStream& blob, int output_idx) const
+{
+	blob << "v" << m_id;
+}
+
+ShaderEditorResource::ValueType ShaderEditorResource::Node::getOutputType(int index) const {
+	m_resource.updateTypes();
+	// not computed only if the node is part of a cycle
+	if (index >= m_output_types.size()) return ValueType::FLOAT;
+	return m_output_types[index];
+}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+void ShaderEditorResource::Node::inputSlot() {
+	const u32 id = m_id | (m_input_count << 16);
+	const ImVec2 pos = ImGui::GetCursorScreenPos();
+	m_cached_pins.push({id, ImVec2(pos.x - m_content_origin.x, pos.y - m_content_origin.y), true});
+	ImGuiEx::Pin(id, true);
+	++m_input_count;
+}
+#endif
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+void ShaderEditorResource::Node::outputSlot() {
+	const u32 id = m_id | (m_output_count << 16) | NodeEditor::OUTPUT_FLAG;
+	const ImVec2 pos = ImGui::GetCursorScreenPos();
+	m_cached_pins.push({id, ImVec2(pos.x - m_content_origin.x, pos.y - m_content_origin.y), false});
+	ImGuiEx::Pin(id, false);
+	++m_output_count;
+}
+#endif
+
+ShaderEditorResource::Cost ShaderEditorResource::Node::estimateCost() const {
+	auto channels = [](ValueType type) { return type == ValueType::NONE || type == ValueType::COUNT ? 1 : getChannelsCount(type); };
+	u32 components = getOutputCount() > 0 ? channels(getOutputType(0)) : 1;
+	const Input input = getInput(m_resource, m_id, 0);
+	if (input) components = maximum(components, channels(input.node->getOutputType(input.output_idx)));
+	return getTypeCost(getType(), components);
+}
+
+bool ShaderEditorResource::Node::generateOnce(OutputMemoryStream& blob) {
+	if (m_generated) return true;
+	m_generated = true;
+	// value is printed as a literal by Input::printReference
+	if (m_folded) return true;
+	// value was computed in vertex shader
+	if (m_interpolated) return true;
+	if (!generate(blob)) return false;
+	if (!isInlined()) return true;
+
+	const ValueType type = getOutputType(0);
+	if (type == ValueType::NONE || type == ValueType::COUNT) return true;
+
+	// store the expression in a variable, so it's not pasted in every place it's used
+	OutputMemoryStream expr(m_resource.m_scratch);
+	printReference(expr, 0);
+	bool has_input = false;
+	for (i32 link_idx : m_input_links) has_input = has_input || link_idx >= 0;
+	if ((m_use_count > 1 && has_input) || expr.size() > ShaderEditorResource::MAX_INLINED_EXPRESSION_LENGTH) {
+		blob << "\t\t" << toPrecision(*this, type) << toString(type) << " v" << m_id << " = ";
+		blob.write(expr.data(), expr.size());
+		blob << ";\n";
+		m_hoisted = true;
+	}
+	return true;
+}
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+// skips onGUI and everything it does, e.g. type lookups, the result looks the same apart from the content
+bool ShaderEditorResource::Node::isDrawnAsBox() const {
+	// output node is always drawn fully, it provides canvas origin to the others
+	if (!m_layout_valid || m_selected || this == m_resource.m_nodes[0]) return false;
+	if (m_resource.m_simplified_canvas) return true;
+	const ImVec2 min(m_resource.m_canvas_origin.x + m_pos.x, m_resource.m_canvas_origin.y + m_pos.y);
+	const float margin = ImGui::GetStyle().WindowPadding.x * 2;
+	return !ImGui::IsRectVisible(ImVec2(min.x - margin, min.y - margin), ImVec2(min.x + m_cached_size.x + margin, min.y + m_cached_size.y + margin));
+}
+
+bool ShaderEditorResource::Node::nodeGUI() {
+	const bool as_box = isDrawnAsBox();
+	ImGuiEx::BeginNode(m_id, m_pos, &m_selected);
+	m_content_origin = ImGui::GetCursorScreenPos();
+	bool res = false;
+	if (as_box) {
+		for (const CachedPin& pin : m_cached_pins) {
+			ImGui::SetCursorScreenPos(ImVec2(m_content_origin.x + pin.offset.x, m_content_origin.y + pin.offset.y));
+			ImGuiEx::Pin(pin.id, pin.is_input);
+		}
+		ImGui::SetCursorScreenPos(m_content_origin);
+		ImGui::Dummy(m_cached_size);
+	}
+	else {
+		m_resource.m_canvas_origin = ImVec2(m_content_origin.x - m_pos.x, m_content_origin.y - m_pos.y);
+		m_cached_pins.clear();
+		m_input_count = 0;
+		m_output_count = 0;
+		ImGui::BeginGroup();
+		res = onGUI();
+		ImGui::EndGroup();
+		m_cached_size = ImGui::GetItemRectSize();
+		m_layout_valid = true;
+		ASSERT((m_input_count > 0) == hasInputPins());
+		ASSERT((m_output_count > 0) == hasOutputPins());
+	}
+
+	const bool has_border = m_error.length() > 0 || m_vertex_stage || m_lod_optional;
+	if (m_error.length() > 0) {
+		ImGui::PushStyleColor(ImGuiCol_Border, IM_COL32(0xff, 0, 0, 0xff));
+	}
+	else if (m_vertex_stage) {
+		ImGui::PushStyleColor(ImGuiCol_Border, IM_COL32(0, 0xa0, 0xff, 0xff));
+	}
+	else if (m_lod_optional) {
+		ImGui::PushStyleColor(ImGuiCol_Border, IM_COL32(0xff, 0xa0, 0, 0xff));
+	}
+	ImGuiEx::EndNode();
+	if (has_border) ImGui::PopStyleColor();
+	if (m_error.length() > 0 && ImGui::IsItemHovered()) ImGui::SetTooltip("%s", m_error.c_str());
+	else if (m_resource.m_show_cost_heatmap && m_reachable) {
+		const u32 max_cost = m_resource.m_cost_estimate.max_node_cost;
+		const u32 cost = m_cost.getWeighted();
+		if (max_cost > 0 && cost > 0) {
+			// green to red
+			const float t = cost / (float)max_cost;
+			const ImU32 color = IM_COL32(u8(0xff * t), u8(0xff * (1 - t)), 0, 0x60);
+			ImGui::GetWindowDrawList()->AddRectFilled(ImGui::GetItemRectMin(), ImGui::GetItemRectMax(), color, 4);
+		}
+		if (ImGui::IsItemHovered()) ImGui::SetTooltip("ALU: %d\nTranscendental: %d\nTexture: %d", m_cost.alu, m_cost.transcendental, m_cost.texture);
+	}
+
+	return res;
+}
+#endif
+
+void ShaderEditorResource::writeCodegenSignature(Node& node, OutputMemoryStream& blob) const {
+	blob.write(node.getType());
+	blob.write(node.m_vertex_stage);
+	blob.write(node.m_precision);
+	blob.write(node.m_lod_optional);
+	node.serialize(blob);
+	for (u32 i = 0, c = node.m_input_links.size(); i < c; ++i) {
+		const Input input = getInput(*this, node.m_id, i);
+		blob.write(input ? input.node->m_id : u16(0xffFF));
+		blob.write(input ? input.output_idx : u16(0));
+	}
+}
+
+// structural hashing, nodes are visited in topological order, so inputs are already merged
+void ShaderEditorResource::mergeIdenticalNodes() {
+	Array<Node*> order(m_scratch);
+	computeTopologicalOrder(order);
+	HashMap<u64, Node*> canonical(m_scratch);
+	OutputMemoryStream signature(m_scratch);
+	OutputMemoryStream other_signature(m_scratch);
+	for (Node* n : order) {
+		if (!n->m_reachable || !n->isPure()) continue;
+
+		signature.clear();
+		writeCodegenSignature(*n, signature);
+		const u64 hash = StableHash(signature.data(), (u32)signature.size()).getHashValue();
+		auto iter = canonical.find(hash);
+		if (!iter.isValid()) {
+			canonical.insert(hash, n);
+			continue;
+		}
+
+		// check for hash collision
+		Node* other = iter.value();
+		other_signature.clear();
+		writeCodegenSignature(*other, other_signature);
+		if (other_signature.size() == signature.size() && memcmp(other_signature.data(), signature.data(), signature.size()) == 0) {
+			n->m_alias = other;
+		}
+	}
+}
+
+// value of a dropped LOD-optional node, chosen so its first consumer passes the other input through
+// PBR node uses default values of its outputs instead
+// false if consumers need different values, e.g. 1 for multiply and 0 for add
+static bool getLodNeutralValue(const ShaderEditorResource& resource, const ShaderEditorResource::Node& node, float& value) {
+	bool has_value = false;
+	for (u32 link_idx : node.m_output_links) {
+		const ShaderEditorResource::Link& link = resource.m_links[link_idx];
+		const ShaderEditorResource::Node* to = resource.getNode(link.getToNode());
+		if (!to || !to->m_reachable) continue;
+		float neutral;
+		switch (to->getType()) {
+			case ShaderNodeType::MULTIPLY: neutral = 1; break;
+			case ShaderNodeType::DIVIDE:
+			case ShaderNodeType::POW:
+				neutral = link.getToPin() == 1 ? 1.f : 0.f;
+				break;
+			default: neutral = 0; break;
+		}
+		if (has_value && neutral != value) return false;
+		value = neutral;
+		has_value = true;
+	}
+	if (!has_value) value = 0;
+	return true;
+}
+
+bool ShaderEditorResource::isLodReduced() const {
+	if (!m_permuting) return false;
+	const i32 define_idx = m_permutation_defines.find([](const String& d) { return d == LOD_DEFINE; });
+	return define_idx >= 0 && (m_permutation_mask & (1 << define_idx));
+}
+
+u32 ShaderEditorResource::foldConstants() {
+	Array<Node*> order(m_scratch);
+	computeTopologicalOrder(order);
+	updateLinkIndex();
+	const bool lod_reduced = isLodReduced();
+	u32 eliminated = 0;
+	for (Node* n : order) {
+		if (!n->m_reachable || n->m_alias) continue;
+
+		Constant value;
+		// the whole subgraph feeding n is dead, unless something else uses it
+		if (lod_reduced && n->m_lod_optional && n->getOutputCount() == 1 && isFoldableType(n->getOutputType(0))) {
+			float neutral;
+			if (getLodNeutralValue(*this, *n, neutral)) {
+				value.type = n->getOutputType(0);
+				for (float& v : value.value) v = neutral;
+				n->m_folded = true;
+				n->m_lod_dropped = true;
+				n->m_constant = value;
+				++eliminated;
+				continue;
+			}
+			// any constant would change the result of some consumer
+			n->m_error = "Consumers need different neutral values, the node is kept in reduced LOD";
+		}
+
+		if (n->getOutputCount() == 1 && n->fold(value)) {
+			n->m_folded = true;
+			n->m_constant = value;
+			if (!isConstantNode(n->getType())) ++eliminated;
+			continue;
+		}
+
+		Node* alias;
+		u16 alias_output;
+		if (n->simplify(alias, alias_output)) {
+			n->m_alias = alias;
+			n->m_alias_output = alias_output;
+			++eliminated;
+		}
+	}
+	return eliminated;
+}
+
+void ShaderEditorResource::markLiveNodes() {
+	for (Node* n : m_nodes) n->m_live = false;
+	Array<Node*> stack(m_scratch);
+	m_nodes[0]->m_live = true;
+	stack.push(m_nodes[0]);
+	while (!stack.empty()) {
+		Node* n = stack.back();
+		stack.pop();
+		// folded nodes do not use their inputs
+		if (n->m_folded) continue;
+		for (u32 i = 0, c = n->m_input_links.size(); i < c; ++i) {
+			// getInput resolves aliases, so merged and pruned nodes are not live
+			const Input input = getInput(*this, n->m_id, i);
+			if (!input || input.node->m_live) continue;
+			input.node->m_live = true;
+			stack.push(input.node);
+		}
+	}
+}
+
+void ShaderEditorResource::countUses() {
+	for (Node* n : m_nodes) n->m_use_count = 0;
+	for (const Link& link : m_links) {
+		Node* to = getNode(link.getToNode());
+		// folded nodes do not use their inputs
+		if (!to || !to->m_live || to->m_folded) continue;
+		Node* from = getNode(link.getFromNode());
+		while (from && from->m_alias) from = from->m_alias;
+		if (from) ++from->m_use_count;
+	}
+}
+
+u32 ShaderEditorResource::prepareCodegen() {
+	for (Node* n : m_nodes) {
+		n->m_generated = false;
+		n->m_hoisted = false;
+		n->m_alias = nullptr;
+		n->m_alias_output = -1;
+		n->m_folded = false;
+		n->m_lod_dropped = false;
+		n->m_interpolated = false;
+	}
+	mergeIdenticalNodes();
+	const u32 eliminated = foldConstants();
+	markLiveNodes();
+	countUses();
+	inferPrecision();
+	return eliminated;
+}
+
+// a node belongs to the branch if all its uses are from the branch
+void ShaderEditorResource::collectBranchNodes(const Node& node, u16 pin, bool uniform, Array<Node*>& nodes) const {
+	nodes.clear();
+	const Input root = getInput(*this, node.m_id, pin);
+	if (!root) return;
+	HashMap<u16, u32> branch_uses(m_scratch);
+	auto add_use = [&](Node* n) {
+		auto iter = branch_uses.find(n->m_id);
+		const u32 uses = iter.isValid() ? iter.value() + 1 : 1;
+		if (iter.isValid()) iter.value() = uses;
+		else branch_uses.insert(n->m_id, uses);
+		// texture fetches with implicit derivatives are undefined in non-uniform control flow, so they stay outside
+		// with their inputs, e.g. samples, scene depth, code and functions sampling textures
+		if (uses == n->m_use_count && (uniform || n->estimateCost().texture == 0)) nodes.push(n);
+	};
+	add_use(root.node);
+	// nodes grows while we iterate
+	for (i32 i = 0; i < nodes.size(); ++i) {
+		Node* n = nodes[i];
+		// folded and interpolated nodes do not use their inputs in generated code
+		if (n->m_folded || n->m_interpolated) continue;
+		for (u32 j = 0, c = n->m_input_links.size(); j < c; ++j) {
+			const Input input = getInput(*this, n->m_id, j);
+			if (input) add_use(input.node);
+		}
+	}
+}
+
+void ShaderEditorResource::inferPrecision() {
+	for (Node* n : m_nodes) n->m_low_precision = false;
+	if (m_nodes.empty() || m_nodes[0]->getType() != ShaderNodeType::PBR) return;
+	if (!((const PBRNode*)m_nodes[0])->m_reduced_precision) return;
+
+	// NEUTRAL - constants, they do not force any precision
+	enum : u8 { NEUTRAL, LOW, HIGH };
+	Array<Node*> order(m_scratch);
+	computeTopologicalOrder(order);
+	HashMap<u16, u8> precision(m_scratch);
+	auto input_precision = [&](const Node& n, u32 pin) -> u8 {
+		const Input input = getInput(*this, n.m_id, pin);
+		if (!input) return NEUTRAL;
+		auto iter = precision.find(input.node->m_id);
+		return iter.isValid() ? iter.value() : HIGH;
+	};
+
+	// inputs first, low precision propagates from colors and textures through math which does not use positions or UVs
+	for (Node* n : order) {
+		if (!n->m_live) continue;
+		u8 max_input = NEUTRAL;
+		for (u32 i = 0, c = n->m_input_links.size(); i < c; ++i) max_input = maximum(max_input, input_precision(*n, i));
+
+		u8 p = max_input;
+		switch (n->getType()) {
+			case ShaderNodeType::POSITION:
+			case ShaderNodeType::NORMAL:
+			case ShaderNodeType::UV0:
+			case ShaderNodeType::PIXEL_DEPTH:
+			case ShaderNodeType::SCENE_DEPTH:
+			case ShaderNodeType::SCREEN_POSITION:
+			case ShaderNodeType::VIEW_DIR:
+			case ShaderNodeType::VERTEX_ID:
+			case ShaderNodeType::TIME:
+			case ShaderNodeType::PARTICLE_STREAM:
+			case ShaderNodeType::CODE:
+			case ShaderNodeType::FUNCTION_INPUT:
+			case ShaderNodeType::FUNCTION_CALL:
+				p = HIGH;
+				break;
+			case ShaderNodeType::SAMPLE:
+			case ShaderNodeType::COLOR_PARAM:
+			case ShaderNodeType::SATURATE:
+				p = LOW;
+				break;
+			case ShaderNodeType::MIX:
+			case ShaderNodeType::ONEMINUS:
+				p = max_input == HIGH ? HIGH : LOW;
+				break;
+			default: break;
+		}
+		if (n->m_folded) p = NEUTRAL;
+		if (n->m_precision == Precision::LOW) p = LOW;
+		else if (n->m_precision == Precision::HIGH) p = HIGH;
+		precision.insert(n->m_id, p);
+	}
+
+	// consumers first, UVs, position offset and values interpolated from vertex shader need full precision of all their inputs
+	HashMap<u16, bool> needs_high(m_scratch);
+	auto require_high = [&](const Node& n, u32 pin) {
+		const Input input = getInput(*this, n.m_id, pin);
+		if (input && !needs_high.find(input.node->m_id).isValid()) needs_high.insert(input.node->m_id, true);
+	};
+	for (i32 i = order.size() - 1; i >= 0; --i) {
+		Node* n = order[i];
+		if (!n->m_live) continue;
+		const bool high = n->m_vertex_stage || needs_high.find(n->m_id).isValid();
+		if (n == m_nodes[0]) require_high(*n, PBRNode::POSITION_OFFSET_INPUT);
+		else if (n->getType() == ShaderNodeType::SAMPLE) require_high(*n, 0);
+		else if (high) {
+			for (u32 pin = 0, c = n->m_input_links.size(); pin < c; ++pin) require_high(*n, pin);
+		}
+
+		if (n->m_precision == Precision::LOW) n->m_low_precision = true;
+		else n->m_low_precision = !high && precision.find(n->m_id).value() == LOW;
+	}
+}
+
+u32 ShaderEditorResource::prepareVariant(u32 variant_idx) {
+	m_permutation_mask = m_variants[variant_idx].masks[0];
+	return prepareCodegen();
+}
+
+u64 ShaderEditorResource::hashLiveGraph() const {
+	OutputMemoryStream blob(m_scratch);
+	for (Node* n : m_nodes) {
+		if (!n->m_live) continue;
+		blob.write(n->m_id);
+		if (n->m_folded) {
+			blob.write(n->m_constant);
+			blob.write(n->m_lod_dropped);
+		}
+		else writeCodegenSignature(*n, blob);
+	}
+	return StableHash(blob.data(), (u32)blob.size()).getHashValue();
+}
+
+void ShaderEditorResource::collectVariants() {
+	m_permuting = false;
+	m_permutation_mask = 0;
+	m_permutation_defines.clear();
+	m_variants.clear();
+
+	const Node* root = m_nodes[0];
+	if (root->getType() == ShaderNodeType::PBR && ((const PBRNode*)root)->m_compile_permutations) {
+		for (const Node* n : m_nodes) {
+			if (!n->m_reachable || n->getType() != ShaderNodeType::STATIC_SWITCH) continue;
+			const String& define = ((const StaticSwitchNode*)n)->m_define;
+			if (define.length() == 0) continue;
+			if (m_permutation_defines.find([&](const String& d){ return d == define; }) >= 0) continue;
+			i32 insert_idx = 0;
+			while (insert_idx < m_permutation_defines.size() && compareString(m_permutation_defines[insert_idx].c_str(), define.c_str()) < 0) ++insert_idx;
+			m_permutation_defines.emplaceAt(insert_idx, define.c_str(), m_allocator);
+		}
+	}
+
+	if (root->getType() == ShaderNodeType::PBR && ((const PBRNode*)root)->m_lod_variants) {
+		const bool has_lod_optional = m_nodes.find([](const Node* n){ return n->m_reachable && n->m_lod_optional; }) >= 0;
+		if (has_lod_optional && m_permutation_defines.find([](const String& d){ return d == LOD_DEFINE; }) < 0) {
+			i32 insert_idx = 0;
+			while (insert_idx < m_permutation_defines.size() && compareString(m_permutation_defines[insert_idx].c_str(), LOD_DEFINE) < 0) ++insert_idx;
+			m_permutation_defines.emplaceAt(insert_idx, LOD_DEFINE, m_allocator);
+		}
+	}
+
+	if (m_permutation_defines.size() > MAX_PERMUTATION_DEFINES) {
+		// static switches stay as #ifdef in the code, but reduced LOD still drops its nodes
+		const bool has_lod = m_permutation_defines.find([](const String& d){ return d == LOD_DEFINE; }) >= 0;
+		m_permutation_defines.clear();
+		if (has_lod) m_permutation_defines.emplace(LOD_DEFINE, m_allocator);
+	}
+
+	const u32 defines_count = m_permutation_defines.size();
+	if (defines_count == 0) {
+		m_variants.emplace(m_allocator).masks.push(0);
+		return;
+	}
+
+	m_permuting = true;
+	for (u32 mask = 0; mask < (1u << defines_count); ++mask) {
+		m_permutation_mask = mask;
+		const u32 eliminated = prepareCodegen();
+		const u64 hash = hashLiveGraph();
+		i32 variant_idx = m_variants.find([&](const Variant& v){ return v.hash == hash; });
+		if (variant_idx < 0) {
+			variant_idx = m_variants.size();
+			Variant& variant = m_variants.emplace(m_allocator);
+			variant.hash = hash;
+			variant.eliminated_nodes_count = eliminated;
+		}
+		m_variants[variant_idx].masks.push(mask);
+	}
+}
+
+void ShaderEditorResource::writeVariantCondition(u32 variant_idx, OutputMemoryStream& blob) const {
+	const Variant& variant = m_variants[variant_idx];
+	for (u32 mask : variant.masks) {
+		if (mask != variant.masks[0]) blob << " || ";
+		blob << "(";
+		for (u32 i = 0, c = m_permutation_defines.size(); i < c; ++i) {
+			if (i > 0) blob << " && ";
+			if ((mask & (1 << i)) == 0) blob << "!";
+			blob << "defined(" << m_permutation_defines[i].c_str() << ")";
+		}
+		blob << ")";
+	}
+}
+
+u64 ShaderEditorResource::computeContentHash() const {
+	HashMap<u64, u64> hashes(m_allocator);
+	return computeContentHash(hashes);
+}
+
+u64 ShaderEditorResource::computeContentHash(HashMap<u64, u64>& hashes) const {
+	updateLinkIndex();
+	OutputMemoryStream blob(m_allocator);
+	blob.write(CODEGEN_VERSION);
+	for (Node* n : m_nodes) {
+		blob.write(n->m_id);
+		blob.write(n->getType());
+		blob.write(n->m_vertex_stage);
+		blob.write(n->m_precision);
+		blob.write(n->m_lod_optional);
+		n->serialize(blob);
+		if (n->getType() == ShaderNodeType::FUNCTION_CALL) {
+			ShaderEditorResource* fn = ((FunctionCallNode*)n)->m_function_resource;
+			u64 fn_hash = 0;
+			if (fn && fn->ensureLoaded()) {
+				const u64 key = fn->m_path.getHash().getHashValue();
+				auto iter = hashes.find(key);
+				if (iter.isValid()) {
+					fn_hash = iter.value();
+				}
+				else {
+					fn_hash = fn->computeContentHash(hashes);
+					hashes.insert(key, fn_hash);
+				}
+			}
+			blob.write(fn_hash);
+		}
+		// links in pin order, order in m_links changes when links are removed
+		for (i32 link_idx : n->m_input_links) {
+			const u32 from = link_idx < 0 ? 0xffFFffFF : m_links[link_idx].from;
+			blob.write(from);
+		}
+	}
+	return StableHash(blob.data(), (u32)blob.size()).getHashValue();
+}
+
+void ShaderEditorResource::packTextureMasks() {
+	m_packed_textures.clear();
+	for (Node* n : m_nodes) {
+		if (n->getType() == ShaderNodeType::SAMPLE) ((SampleNode*)n)->m_packed_texture = -1;
+	}
+	if (m_nodes.empty() || m_nodes[0]->getType() != ShaderNodeType::PBR) return;
+	if (!((const PBRNode*)m_nodes[0])->m_pack_texture_masks) return;
+	updateLinkIndex();
+
+	// UV source of each packed texture
+	Array<u64> packed_uvs(m_allocator);
+	for (Node* n : m_nodes) {
+		if (!n->m_reachable || n->getType() != ShaderNodeType::SAMPLE) continue;
+
+		// mask is a texture used only through swizzles of the same single channel
+		char channel = 0;
+		bool is_mask = true;
+		for (u32 link_idx : n->m_output_links) {
+			const Node* to = getNode(m_links[link_idx].getToNode());
+			if (!to || !to->m_reachable) continue;
+			const char* swizzle = to->getType() == ShaderNodeType::SWIZZLE ? ((const SwizzleNode*)to)->m_swizzle.data : "";
+			if (stringLength(swizzle) != 1 || (channel && channel != swizzle[0])) {
+				is_mask = false;
+				break;
+			}
+			channel = swizzle[0];
+		}
+		if (!is_mask || !channel) continue;
+
+		SampleNode* sample = (SampleNode*)n;
+		const i32 uv_link = getInputLink(*n, 0);
+		const u64 uv = uv_link < 0 ? 0xffFFffFFffFFffFF : m_links[uv_link].from;
+		for (u32 i = 0, c = m_packed_textures.size(); i < c && sample->m_packed_texture < 0; ++i) {
+			if (packed_uvs[i] != uv) continue;
+			PackedTexture& packed = m_packed_textures[i];
+			for (u32 j = 0, cj = packed.sources.size(); j < cj; ++j) {
+				if (packed.sources[j] == sample->m_texture && packed.source_channels[j] == channel) {
+					sample->m_packed_texture = i;
+					sample->m_packed_channel = "xyzw"[j];
+				}
+			}
+			if (sample->m_packed_texture < 0 && packed.sources.size() < 4) {
+				sample->m_packed_texture = i;
+				sample->m_packed_channel = "xyzw"[packed.sources.size()];
+				packed.source_channels[packed.sources.size()] = channel;
+				packed.sources.emplace(sample->m_texture.c_str(), m_allocator);
+			}
+		}
+		if (sample->m_packed_texture >= 0) continue;
+
+		sample->m_packed_texture = m_packed_textures.size();
+		sample->m_packed_channel = 'x';
+		PackedTexture& packed = m_packed_textures.emplace(m_allocator);
+		packed.source_channels[0] = channel;
+		packed.sources.emplace(sample->m_texture.c_str(), m_allocator);
+		packed_uvs.push(uv);
+	}
+
+	// textures with a single source are not worth packing
+	Array<i32> remap(m_allocator);
+	Array<PackedTexture> packed_textures(m_allocator);
+	for (PackedTexture& packed : m_packed_textures) {
+		if (packed.sources.size() < 2) {
+			remap.push(-1);
+			continue;
+		}
+		remap.push(packed_textures.size());
+		const StaticString<64> name("Packed masks ", packed_textures.size());
+		packed.name = name;
+		packed_textures.push(static_cast<PackedTexture&&>(packed));
+	}
+	m_packed_textures = static_cast<Array<PackedTexture>&&>(packed_textures);
+	for (Node* n : m_nodes) {
+		if (n->getType() != ShaderNodeType::SAMPLE) continue;
+		SampleNode* sample = (SampleNode*)n;
+		if (sample->m_packed_texture >= 0) sample->m_packed_texture = remap[sample->m_packed_texture];
+	}
+}
+
+void ShaderEditorResource::writePackingManifest(OutputMemoryStream& blob) const {
+	blob << "packed_textures = {\n";
+	for (const PackedTexture& packed : m_packed_textures) {
+		blob << "\t{\n\t\tname = \"" << packed.name.c_str() << "\",\n\t\tchannels = {\n";
+		for (u32 i = 0, c = packed.sources.size(); i < c; ++i) {
+			const char channel[] = { packed.source_channels[i], 0 };
+			blob << "\t\t\t{ texture = \"" << packed.sources[i].c_str() << "\", channel = \"" << channel << "\" },\n";
+		}
+		blob << "\t\t}\n\t},\n";
+	}
+	blob << "}\n";
+}
+
+void ShaderEditorResource::writeParticleStreamsManifest(OutputMemoryStream& blob) const {
+	blob << "particle_streams = {\n";
+	for (const ParticleStream& stream : m_particle_streams) {
+		blob << "\t{ name = \"" << stream.name.c_str() << "\", stream = " << stream.stream << ", components = \"" << getComponents(stream.mask) << "\" },\n";
+	}
+	blob << "}\n";
+}
+
+u32 ShaderEditorResource::getCostBudget() const {
+	if (m_nodes.empty() || m_nodes[0]->getType() != ShaderNodeType::PBR) return 0;
+	return ((const PBRNode*)m_nodes[0])->m_cost_budget;
+}
+
+bool ShaderEditorResource::checkCostBudget() {
+	estimateCost();
+	const u32 budget = getCostBudget();
+	const u32 cost = m_cost_estimate.fragment.getWeighted();
+	if (budget == 0 || cost <= budget) return true;
+	logError(m_path, ": estimated fragment cost ", cost, " exceeds budget ", budget);
+	return false;
+}
+
+void ShaderEditorResource::writeCostReport(OutputMemoryStream& blob) {
+	estimateCost();
+	auto write_cost = [&](const char* name, const Cost& cost) {
+		blob << ", \"" << name << "\": {\"alu\": " << cost.alu
+			<< ", \"transcendental\": " << cost.transcendental
+			<< ", \"texture\": " << cost.texture
+			<< ", \"weighted\": " << cost.getWeighted() << "}";
+	};
+	blob << "{\"path\": \"" << m_path.c_str() << "\", \"hash\": \"" << computeContentHash() << "\"";
+	write_cost("fragment", m_cost_estimate.fragment);
+	write_cost("vertex", m_cost_estimate.vertex);
+	blob << ", \"budget\": " << getCostBudget() << "}\n";
+}
+
+void ShaderEditorResource::estimateCost() {
+	enum : u8 { VERTEX = 1, FRAGMENT = 2 };
+
+	m_estimating_cost = true;
+	m_cost_estimate = {};
+	markReachableNodes();
+	updateTypes();
+	Array<Node*> order(m_allocator);
+	computeTopologicalOrder(order);
+
+	// stages which need the value of a node, consumers come before their inputs in reversed order
+	HashMap<u16, u8> stages(m_allocator);
+	for (i32 i = order.size() - 1; i >= 0; --i) {
+		Node* n = order[i];
+		n->m_cost = {};
+		if (!n->m_reachable) continue;
+
+		u8 node_stages = n == m_nodes[0] ? FRAGMENT : 0;
+		if (n->m_vertex_stage) node_stages = VERTEX;
+		else {
+			for (u32 link_idx : n->m_output_links) {
+				const Link& link = m_links[link_idx];
+				Node* to = getNode(link.getToNode());
+				if (!to || !to->m_reachable) continue;
+				if (to == m_nodes[0]) {
+					const bool vertex_input = getShaderType() == ShaderResourceEditorType::SURFACE && link.getToPin() == PBRNode::POSITION_OFFSET_INPUT;
+					node_stages |= vertex_input ? VERTEX : FRAGMENT;
+					continue;
+				}
+				auto iter = stages.find(to->m_id);
+				if (iter.isValid()) node_stages |= iter.value();
+			}
+		}
+		stages.insert(n->m_id, node_stages);
+
+		n->m_cost = n->estimateCost();
+		if (node_stages & VERTEX) m_cost_estimate.vertex.add(n->m_cost);
+		if (node_stages & FRAGMENT) m_cost_estimate.fragment.add(n->m_cost);
+		m_cost_estimate.max_node_cost = maximum(m_cost_estimate.max_node_cost, n->m_cost.getWeighted());
+	}
+	m_estimating_cost = false;
+}
+
+ShaderEditorResource::ValueType ShaderEditorResource::getFunctionOutputType() const {
+	for (const Node* n : m_nodes) {
+		if (n->getType() == ShaderNodeType::FUNCTION_OUTPUT) {
+			const Input input = getInput(*this, n->m_id, 0);
+			if (!input) return ShaderEditorResource::ValueType::NONE;
+
+			return input.node->getOutputType(input.output_idx);
+		}
+	}
+	ASSERT(false);
+	return ShaderEditorResource::ValueType::NONE;
+}
+
+u32 ShaderEditorResource::StringTableWriter::add(const char* str) {
+	const u64 hash = StableHash(str, stringLength(str)).getHashValue();
+	auto iter = map.find(hash);
+	if (iter.isValid() && equalStrings(strings[iter.value()], str)) return iter.value();
+	// on hash collision the string is stored twice, which is still valid
+	const u32 idx = strings.size();
+	strings.push(str);
+	if (!iter.isValid()) map.insert(hash, idx);
+	return idx;
+}
+
+void ShaderEditorResource::updateSignature() {
+	m_function_inputs.clear();
+	for (const Node* node : m_nodes) {
+		if (node->getType() != ShaderNodeType::FUNCTION_INPUT) continue;
+		const FunctionInputNode* n = (const FunctionInputNode*)node;
+		m_function_inputs.emplace(n->m_name.c_str(), n->m_type, m_allocator);
+	}
+	m_function_output_type = getFunctionOutputType();
+}
+
+ShaderResourceEditorType ShaderEditorResource::getShaderType() const {
+	
+	switch (m_nodes[0]->getType()) {
+		case ShaderNodeType::PBR: return ((PBRNode*)m_nodes[0])->m_type == PBRNode::Type::PARTICLES 
+			? ShaderResourceEditorType::PARTICLE 
+			: ShaderResourceEditorType::SURFACE;
+		case ShaderNodeType::FUNCTION_OUTPUT: return ShaderResourceEditorType::FUNCTION;
+		default: ASSERT(false); return ShaderResourceEditorType::SURFACE;
+	}
+}
+
+void ShaderEditorResource::init(ShaderResourceEditorType type) {
+	Node* node = nullptr;
+	switch(type) {
+		case ShaderResourceEditorType::PARTICLE:
+		case ShaderResourceEditorType::SURFACE: {
+			PBRNode* output = LUMIX_NEW(m_node_allocator, PBRNode)(*this);
+			output->m_type = (type == ShaderResourceEditorType::PARTICLE) ? PBRNode::Type::PARTICLES : PBRNode::Type::SURFACE;
+			node = output;
+			break;
+		}
+		case ShaderResourceEditorType::FUNCTION: {
+			node = LUMIX_NEW(m_node_allocator, FunctionOutputNode)(*this);
+			break;
+		}
+	}
+	ASSERT(node);
+	node->m_pos.x = 50;
+	node->m_pos.y = 50;
+	node->m_id = ++m_last_node_id;
+	addNode(node);
+}
+
+ShaderEditorResource::Node* ShaderEditorResource::createNode(int type) {
+	switch ((ShaderNodeType)type) {
+		case ShaderNodeType::PBR:						return LUMIX_NEW(m_node_allocator, PBRNode)(*this);
+		case ShaderNodeType::PIN:						return LUMIX_NEW(m_node_allocator, PinNode)(*this);
+		case ShaderNodeType::VEC4:						return LUMIX_NEW(m_node_allocator, ConstNode<ValueType::VEC4>)(*this);
+		case ShaderNodeType::VEC3:						return LUMIX_NEW(m_node_allocator, ConstNode<ValueType::VEC3>)(*this);
+		case ShaderNodeType::VEC2:						return LUMIX_NEW(m_node_allocator, ConstNode<ValueType::VEC2>)(*this);
+		case ShaderNodeType::NUMBER:					return LUMIX_NEW(m_node_allocator, ConstNode<ValueType::FLOAT>)(*this);
+		case ShaderNodeType::SAMPLE:					return LUMIX_NEW(m_node_allocator, SampleNode)(*this, m_node_allocator);
+		case ShaderNodeType::MULTIPLY:					return LUMIX_NEW(m_node_allocator, OperatorNode<ShaderNodeType::MULTIPLY>)(*this);
+		case ShaderNodeType::ADD:						return LUMIX_NEW(m_node_allocator, OperatorNode<ShaderNodeType::ADD>)(*this);
+		case ShaderNodeType::DIVIDE:					return LUMIX_NEW(m_node_allocator, OperatorNode<ShaderNodeType::DIVIDE>)(*this);
+		case ShaderNodeType::SUBTRACT:					return LUMIX_NEW(m_node_allocator, OperatorNode<ShaderNodeType::SUBTRACT>)(*this);
+		case ShaderNodeType::PARTICLE_STREAM:			return LUMIX_NEW(m_node_allocator, ParticleStreamNode)(*this);
+		case ShaderNodeType::SWIZZLE:					return LUMIX_NEW(m_node_allocator, SwizzleNode)(*this);
+		case ShaderNodeType::TIME:						return LUMIX_NEW(m_node_allocator, UniformNode<ShaderNodeType::TIME>)(*this);
+		case ShaderNodeType::VIEW_DIR:					return LUMIX_NEW(m_node_allocator, UniformNode<ShaderNodeType::VIEW_DIR>)(*this);
+		case ShaderNodeType::PIXEL_DEPTH:				return LUMIX_NEW(m_node_allocator, UniformNode<ShaderNodeType::PIXEL_DEPTH>)(*this);
+		case ShaderNodeType::SCENE_DEPTH:				return LUMIX_NEW(m_node_allocator, UniformNode<ShaderNodeType::SCENE_DEPTH>)(*this);
+		case ShaderNodeType::SCREEN_POSITION:			return LUMIX_NEW(m_node_allocator, UniformNode<ShaderNodeType::SCREEN_POSITION>)(*this);
+		case ShaderNodeType::VERTEX_ID:					return LUMIX_NEW(m_node_allocator, VertexIDNode)(*this);
+		case ShaderNodeType::BACKFACE_SWITCH:			return LUMIX_NEW(m_node_allocator, BackfaceSwitchNode)(*this);
+		case ShaderNodeType::IF:						return LUMIX_NEW(m_node_allocator, IfNode)(*this);
+		case ShaderNodeType::STATIC_SWITCH:				return LUMIX_NEW(m_node_allocator, StaticSwitchNode)(*this, m_node_allocator);
+		case ShaderNodeType::FUNCTION_INPUT:			return LUMIX_NEW(m_node_allocator, FunctionInputNode)(*this, m_node_allocator);
+		case ShaderNodeType::FUNCTION_OUTPUT:			return LUMIX_NEW(m_node_allocator, FunctionOutputNode)(*this);
+		case ShaderNodeType::FUNCTION_CALL:				return LUMIX_NEW(m_node_allocator, FunctionCallNode)(*this);
+		case ShaderNodeType::ONEMINUS:					return LUMIX_NEW(m_node_allocator, OneMinusNode)(*this);
+		case ShaderNodeType::CODE:						return LUMIX_NEW(m_node_allocator, CodeNode)(*this, m_node_allocator);
+		case ShaderNodeType::APPEND:					return LUMIX_NEW(m_node_allocator, AppendNode)(*this);
+		case ShaderNodeType::FRESNEL:					return LUMIX_NEW(m_node_allocator, FresnelNode)(*this);
+		case ShaderNodeType::POSITION:					return LUMIX_NEW(m_node_allocator, PositionNode)(*this);
+		case ShaderNodeType::NORMAL:					return LUMIX_NEW(m_node_allocator, VaryingNode<ShaderNodeType::NORMAL>)(*this);
+		case ShaderNodeType::UV0:						return LUMIX_NEW(m_node_allocator, VaryingNode<ShaderNodeType::UV0>)(*this);
+		case ShaderNodeType::SCALAR_PARAM:				return LUMIX_NEW(m_node_allocator, ParameterNode<ShaderNodeType::SCALAR_PARAM>)(*this, m_node_allocator);
+		case ShaderNodeType::COLOR_PARAM:				return LUMIX_NEW(m_node_allocator, ParameterNode<ShaderNodeType::COLOR_PARAM>)(*this, m_node_allocator);
+		case ShaderNodeType::VEC4_PARAM:				return LUMIX_NEW(m_node_allocator, ParameterNode<ShaderNodeType::VEC4_PARAM>)(*this, m_node_allocator);
+		case ShaderNodeType::MIX:						return LUMIX_NEW(m_node_allocator, MixNode)(*this);
+		
+		case ShaderNodeType::ABS:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::ABS>)(*this);
+		case ShaderNodeType::ALL:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::ALL>)(*this);
+		case ShaderNodeType::ANY:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::ANY>)(*this);
+		case ShaderNodeType::CEIL:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::CEIL>)(*this);
+		case ShaderNodeType::COS:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::COS>)(*this);
+		case ShaderNodeType::EXP:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::EXP>)(*this);
+		case ShaderNodeType::EXP2:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::EXP2>)(*this);
+		case ShaderNodeType::FLOOR:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::FLOOR>)(*this);
+		case ShaderNodeType::FRACT:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::FRACT>)(*this);
+		case ShaderNodeType::LOG:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::LOG>)(*this);
+		case ShaderNodeType::LOG2:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::LOG2>)(*this);
+		case ShaderNodeType::NORMALIZE:					return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::NORMALIZE>)(*this);
+		case ShaderNodeType::NOT:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::NOT>)(*this);
+		case ShaderNodeType::ROUND:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::ROUND>)(*this);
+		case ShaderNodeType::SATURATE:					return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::SATURATE>)(*this);
+		case ShaderNodeType::SIN:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::SIN>)(*this);
+		case ShaderNodeType::SQRT:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::SQRT>)(*this);
+		case ShaderNodeType::TAN:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::TAN>)(*this);
+		case ShaderNodeType::TRANSPOSE:					return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::TRANSPOSE>)(*this);
+		case ShaderNodeType::TRUNC:						return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::TRUNC>)(*this);
+		case ShaderNodeType::LENGTH:					return LUMIX_NEW(m_node_allocator, BuiltinFunctionCallNode<ShaderNodeType::LENGTH>)(*this);
+
+		case ShaderNodeType::DOT:						return LUMIX_NEW(m_node_allocator, BinaryBuiltinFunctionCallNode<ShaderNodeType::DOT>)(*this);
+		case ShaderNodeType::CROSS:						return LUMIX_NEW(m_node_allocator, BinaryBuiltinFunctionCallNode<ShaderNodeType::CROSS>)(*this);
+		case ShaderNodeType::MIN:						return LUMIX_NEW(m_node_allocator, BinaryBuiltinFunctionCallNode<ShaderNodeType::MIN>)(*this);
+		case ShaderNodeType::MAX:						return LUMIX_NEW(m_node_allocator, BinaryBuiltinFunctionCallNode<ShaderNodeType::MAX>)(*this);
+		case ShaderNodeType::POW:						return LUMIX_NEW(m_node_allocator, PowerNode)(*this);
+		case ShaderNodeType::DISTANCE:					return LUMIX_NEW(m_node_allocator, BinaryBuiltinFunctionCallNode<ShaderNodeType::DISTANCE>)(*this);
+	}
+
+	ASSERT(false);
+	return nullptr;
+}
+
+bool ShaderEditorResource::load() {
+	PROFILE_FUNCTION();
+	profiler::pushString(m_path.c_str());
+	OutputMemoryStream content(m_allocator);
+	if (!m_compiler.m_fs.getContentSync(m_path, content)) {
+		logError("Failed to read ", m_path);
+		return false;
+	}
+	
+	InputMemoryStream blob(content);
+	if (!deserialize(blob)) {
+		logError("Failed to deserialize ", m_path);
+		return false;
+	}
+	return true;
+}
+
+ShaderEditorResource* ShaderEditorResource::getCalledFunction(const Node& node) {
+	if (node.getType() != ShaderNodeType::FUNCTION_CALL) return nullptr;
+	return ((const FunctionCallNode&)node).m_function_resource;
+}
+
+void ShaderEditorResource::setCalledFunction(Node& node, ShaderEditorResource* fn) {
+	ASSERT(node.getType() == ShaderNodeType::FUNCTION_CALL);
+	((FunctionCallNode&)node).m_function_resource = fn;
+}
+
+void ShaderEditorResource::setParticleStream(Node& node, u32 stream) {
+	ASSERT(node.getType() == ShaderNodeType::PARTICLE_STREAM);
+	((ParticleStreamNode&)node).m_stream = stream;
+}
+
+const Array<String>& ShaderEditorResource::getParticleAttributes() const {
+	return ((const PBRNode*)m_nodes[0])->m_attributes_names;
+}
+
+FunctionLibrary::~FunctionLibrary() {
+	// parse jobs point to functions
+	if (m_async) jobs::wait(&m_parse_jobs);
+	for (ShaderEditorResource* fn : m_functions) LUMIX_DELETE(m_allocator, fn);
+}
+
+void FunctionLibrary::add(const Path& path) {
+	const u64 hash = path.getHash().getHashValue();
+	ShaderEditorResource* fn;
+	{
+		MutexGuard guard(m_mutex);
+		auto iter = m_functions.find(hash);
+		if (!iter.isValid()) {
+			fn = LUMIX_NEW(m_allocator, ShaderEditorResource)(path, m_compiler, m_allocator);
+			fn->m_function_library = this;
+			fn->m_load_state = (i32)LoadState::EMPTY;
+			m_functions.insert(hash, fn);
+			return;
+		}
+		fn = iter.value();
+	}
+
+	// take the function from parse jobs and other threads, so it can be cleared
+	for (;;) {
+		const i32 state = fn->m_load_state;
+		if (state == (i32)LoadState::EMPTY) return;
+		if (state == (i32)LoadState::OPENING || state == (i32)LoadState::PARSING || state == (i32)LoadState::RESOLVING) {
+			waitLoading(*fn, true);
+			continue;
+		}
+		if (beginLoading(*fn, (LoadState)state, LoadState::OPENING)) break;
+	}
+	fn->clear();
+	fn->m_function_inputs.clear();
+	// it was used, so it's probably going to be used again
+	open(*fn);
+}
+
+void FunctionLibrary::open(ShaderEditorResource& fn) {
+	if (m_async && readSignature(fn)) {
+		endLoading(fn, LoadState::SIGNATURE);
+		jobs::run(&fn, &FunctionLibrary::parseJob, &m_parse_jobs);
+		return;
+	}
+	parse(fn);
+}
+
+bool FunctionLibrary::beginLoading(ShaderEditorResource& fn, LoadState from, LoadState to) {
+	ASSERT(to == LoadState::OPENING || to == LoadState::PARSING || to == LoadState::RESOLVING);
+	MutexGuard guard(m_mutex);
+	if (!fn.m_load_state.compareExchange((i32)to, (i32)from)) return false;
+	jobs::setRed(&fn.m_loading);
+	return true;
+}
+
+void FunctionLibrary::endLoading(ShaderEditorResource& fn, LoadState state) {
+	MutexGuard guard(m_mutex);
+	fn.m_load_state = (i32)state;
+	jobs::setGreen(&fn.m_loading);
+}
+
+void FunctionLibrary::waitLoading(ShaderEditorResource& fn, bool parsing) {
+	for (;;) {
+		const i32 state = fn.m_load_state;
+		const bool busy = state == (i32)LoadState::OPENING || (parsing && (state == (i32)LoadState::PARSING || state == (i32)LoadState::RESOLVING));
+		if (!busy) return;
+		// the signal can be still green if the state has just changed, so it's checked again
+		jobs::wait(&fn.m_loading);
+	}
+}
+
+ShaderEditorResource* FunctionLibrary::find(const Path& path, bool wait_for_signature) {
+	if (path.isEmpty()) return nullptr;
+
+	const u64 hash = path.getHash().getHashValue();
+	ShaderEditorResource* fn;
+	bool first_use = false;
+	{
+		MutexGuard guard(m_mutex);
+		auto iter = m_functions.find(hash);
+		if (iter.isValid()) {
+			fn = iter.value();
+		}
+		else {
+			fn = LUMIX_NEW(m_allocator, ShaderEditorResource)(path, m_compiler, m_allocator);
+			fn->m_function_library = this;
+			fn->m_load_state = (i32)LoadState::EMPTY;
+			m_functions.insert(hash, fn);
+		}
+
+		// first use, claimed with the lock held, so it's opened only once
+		if (fn->m_load_state == (i32)LoadState::EMPTY) {
+			fn->m_load_state = (i32)LoadState::OPENING;
+			jobs::setRed(&fn->m_loading);
+			first_use = true;
+		}
+	}
+
+	// deserialization finds other functions, so it must not hold the lock
+	if (first_use) open(*fn);
+	if (wait_for_signature) waitLoading(*fn, false);
+	return fn->m_load_state == (i32)LoadState::FAILED ? nullptr : fn;
+}
+
+bool FunctionLibrary::readSignature(ShaderEditorResource& fn) {
+	// only the header is read, the rest is deserialized later
+	FileSystem& fs = m_compiler.m_fs;
+	os::InputFile file;
+	if (!fs.open(fn.m_path, file)) return false;
+
+	u32 magic;
+	Version version;
+	u32 header_size;
+	bool success = file.read(&magic, sizeof(magic))
+		&& magic == '_LSE'
+		&& file.read(&version, sizeof(version))
+		&& version > Version::FUNCTION_HEADER
+		&& version <= Version::LAST
+		&& file.read(&header_size, sizeof(header_size))
+		// empty header means the graph is not a function
+		&& header_size > 0;
+	OutputMemoryStream header(m_allocator);
+	if (success) {
+		header.resize(header_size);
+		success = file.read(header.getMutableData(), header_size);
+	}
+	file.close();
+	if (!success) return false;
+
+	InputMemoryStream blob(header);
+	fn.readSignature(blob);
+	return true;
+}
+
+void FunctionLibrary::parseJob(void* data) {
+	ShaderEditorResource* fn = (ShaderEditorResource*)data;
+	FunctionLibrary* library = fn->m_function_library;
+	// somebody needed it sooner and parsed it synchronously
+	if (library->beginLoading(*fn, LoadState::SIGNATURE, LoadState::PARSING)) library->parse(*fn);
+}
+
+void FunctionLibrary::parse(ShaderEditorResource& fn) {
+	PROFILE_FUNCTION();
+	profiler::pushString(fn.m_path.c_str());
+	FileSystem& fs = m_compiler.m_fs;
+	OutputMemoryStream data(m_allocator);
+	bool success = fs.getContentSync(fn.m_path, data);
+	if (success) {
+		InputMemoryStream blob(data);
+		success = fn.deserialize(blob) && fn.getShaderType() == ShaderResourceEditorType::FUNCTION;
+	}
+	if (!success) {
+		logError("Failed to load ", fn.m_path);
+		endLoading(fn, LoadState::FAILED);
+		return;
+	}
+	endLoading(fn, LoadState::PARSED);
+}
+
+bool FunctionLibrary::ensureLoaded(ShaderEditorResource& fn) {
+	if (fn.m_load_state == (i32)LoadState::LOADED) return true;
+	MutexGuard guard(m_resolve_mutex);
+	Array<ShaderEditorResource*> stack(m_allocator);
+	Array<ShaderEditorResource*> recursive(m_allocator);
+	return ensureLoaded(fn, stack, recursive);
+}
+
+bool FunctionLibrary::ensureLoaded(ShaderEditorResource& fn, Array<ShaderEditorResource*>& stack, Array<ShaderEditorResource*>& recursive) {
+	if (fn.m_load_state == (i32)LoadState::LOADED) return true;
+
+	const i32 stack_idx = stack.indexOf(&fn);
+	if (stack_idx >= 0) {
+		// every function in the cycle fails, no matter which one is loaded first
+		logError("Recursive call of ", fn.m_path);
+		for (i32 i = stack_idx; i < stack.size(); ++i) {
+			if (recursive.indexOf(stack[i]) < 0) recursive.push(stack[i]);
+		}
+		return false;
+	}
+
+	// parse job has not started yet, so we do not wait for it
+	if (beginLoading(fn, LoadState::SIGNATURE, LoadState::PARSING)) parse(fn);
+	waitLoading(fn, true);
+	// e.g. the function was reloaded meanwhile, it's going to be resolved by the next ensureLoaded
+	if (!beginLoading(fn, LoadState::PARSED, LoadState::RESOLVING)) return fn.m_load_state == (i32)LoadState::LOADED;
+
+	stack.push(&fn);
+	bool success = true;
+	for (ShaderEditorResource::Node* n : fn.m_nodes) {
+		ShaderEditorResource* callee = ShaderEditorResource::getCalledFunction(*n);
+		if (callee && !ensureLoaded(*callee, stack, recursive)) success = false;
+	}
+	stack.pop();
+
+	if (recursive.indexOf(&fn) >= 0) {
+		endLoading(fn, LoadState::FAILED);
+		return false;
+	}
+	// callees can be fixed and loaded again, so `fn` stays parsed
+	if (!success) {
+		endLoading(fn, LoadState::PARSED);
+		return false;
+	}
+
+	// signatures of called functions might not have been loaded when `fn` was parsed
+	fn.invalidateTypes();
+	fn.updateSignature();
+	endLoading(fn, LoadState::LOADED);
+	return true;
+}
+
+ShaderEditorResource* ShaderEditorResource::findFunction(const Path& path) {
+	FunctionLibrary& library = m_function_library ? *m_function_library : m_compiler.m_function_library;
+	// functions being deserialized by the library do not wait, they might be called by the function we would wait for
+	return library.find(path, m_load_state == (i32)LoadState::LOADED);
+}
+
+bool ShaderEditorResource::ensureLoaded() {
+	if (m_load_state == (i32)LoadState::LOADED) return true;
+	return m_function_library->ensureLoaded(*this);
+}
+
+ShaderGraphCompiler::ShaderGraphCompiler(FileSystem& fs, IAllocator& allocator, bool async_functions)
+	: m_allocator(allocator)
+	, m_fs(fs)
+	, m_function_library(*this, allocator, async_functions)
+	, m_compiled_functions(allocator)
+{
+	m_compile_time_counter = profiler::createCounter("Shader graph compile (ms)", 0);
+}
+
+ShaderGraphCompiler::~ShaderGraphCompiler() {
+	for (CompiledFunction* f : m_compiled_functions) LUMIX_DELETE(m_allocator, f);
+}
+
+void ShaderGraphCompiler::addFunction(const Path& path) {
+	invalidateCompiledFunction(path);
+	m_function_library.add(path);
+}
+
+bool ShaderGraphCompiler::writeFunctions(Span<ShaderEditorResource* const> functions, OutputMemoryStream& blob) {
+	PROFILE_FUNCTION();
+	Array<u64> order(m_allocator);
+	// content of the resources does not change while we compile them
+	HashMap<u64, u64> hashes(m_allocator);
+	// a function can be changed, i.e. its entries invalidated, after it was compiled, it's compiled again in such case
+	for (u32 attempt = 0; attempt < MAX_FUNCTION_COMPILE_ATTEMPTS; ++attempt) {
+		order.clear();
+		for (ShaderEditorResource* fn : functions) {
+			if (!compileFunction(*fn, order, hashes)) return false;
+		}
+
+		MutexGuard guard(m_compiled_functions_mutex);
+		const bool all_valid = order.find([&](u64 key){ return !m_compiled_functions.find(key).isValid(); }) < 0;
+		if (!all_valid) continue;
+		for (u64 key : order) {
+			blob << m_compiled_functions.find(key).value()->code.c_str() << "\n\n";
+		}
+		return true;
+	}
+	logError("Functions kept changing while they were compiled");
+	return false;
+}
+
+bool ShaderGraphCompiler::compileFunction(ShaderEditorResource& fn, Array<u64>& order, HashMap<u64, u64>& hashes) {
+	if (!fn.ensureLoaded()) return false;
+	const u64 path_hash = fn.m_path.getHash().getHashValue();
+	u64 content_hash;
+	auto hash_iter = hashes.find(path_hash);
+	if (hash_iter.isValid()) {
+		content_hash = hash_iter.value();
+	}
+	else {
+		content_hash = fn.computeContentHash(hashes);
+		hashes.insert(path_hash, content_hash);
+	}
+	const u64 hashes[] = { path_hash, content_hash };
+	const u64 key = StableHash(hashes, sizeof(hashes)).getHashValue();
+	if (order.indexOf(key) >= 0) return true;
+
+	auto push_with_dependencies = [&](const CompiledFunction& f) {
+		for (u64 dep : f.dependencies) {
+			if (order.indexOf(dep) < 0) order.push(dep);
+		}
+		order.push(key);
+	};
+
+	{
+		MutexGuard guard(m_compiled_functions_mutex);
+		auto iter = m_compiled_functions.find(key);
+		if (iter.isValid()) {
+			m_stats.function_cache_hits.inc();
+			push_with_dependencies(*iter.value());
+			return true;
+		}
+	}
+
+	PROFILE_BLOCK("compile function");
+	profiler::pushString(fn.m_path.c_str());
+	m_stats.function_cache_misses.inc();
+	CompiledFunction* compiled = LUMIX_NEW(m_allocator, CompiledFunction)(fn.m_path, key, m_allocator);
+	fn.clearGeneratedFlags();
+	if (!fn.generate(&compiled->code)) {
+		logError("Failed to generate ", fn.m_path);
+		LUMIX_DELETE(m_allocator, compiled);
+		return false;
+	}
+	// live marks are valid until the next generate, callees are other resources, so they do not touch them
+	for (ShaderEditorResource::Node* n : fn.m_nodes) {
+		if (!n->m_live || n->getType() != ShaderNodeType::FUNCTION_CALL) continue;
+		ShaderEditorResource* callee = ((FunctionCallNode*)n)->m_function_resource;
+		if (callee && !compileFunction(*callee, compiled->dependencies, hashes)) {
+			LUMIX_DELETE(m_allocator, compiled);
+			return false;
+		}
+	}
+
+	MutexGuard guard(m_compiled_functions_mutex);
+	// the same function with the same content can be compiled by another job meanwhile, i.e. with a different resource
+	auto iter = m_compiled_functions.find(key);
+	if (iter.isValid()) {
+		LUMIX_DELETE(m_allocator, compiled);
+		compiled = iter.value();
+	}
+	else {
+		m_compiled_functions.insert(key, compiled);
+	}
+	push_with_dependencies(*compiled);
+	return true;
+}
+
+void ShaderGraphCompiler::onGraphCompiled(const Path& path, bool success, float time) {
+	if (success) m_stats.compiled_graphs.inc();
+	else m_stats.failed_graphs.inc();
+	m_stats.compile_time_us.add(i64(time * 1000000));
+	profiler::pushCounter(m_compile_time_counter, time * 1000);
+
+	MutexGuard guard(m_stats_mutex);
+	if (time > m_stats.slowest_graph_time) {
+		m_stats.slowest_graph_time = time;
+		m_stats.slowest_graph = path;
+	}
+}
+
+void ShaderGraphCompiler::invalidateCompiledFunction(const Path& path) {
+	MutexGuard guard(m_compiled_functions_mutex);
+	Array<u64> invalid(m_allocator);
+	for (CompiledFunction* f : m_compiled_functions) {
+		bool is_invalid = f->path == path;
+		// dependencies are transitive, so checking them is enough to find indirect callers too
+		for (u64 dep : f->dependencies) {
+			auto iter = m_compiled_functions.find(dep);
+			is_invalid = is_invalid || !iter.isValid() || iter.value()->path == path;
+		}
+		if (is_invalid) invalid.push(f->key);
+	}
+	for (u64 key : invalid) {
+		auto iter = m_compiled_functions.find(key);
+		LUMIX_DELETE(m_allocator, iter.value());
+		m_compiled_functions.erase(iter);
+	}
+}
+
+} // namespace Lumix
@@ -0,0 +1,1402 @@
+#pragma once
+
+#include "core/allocator.h"
+#include "core/array.h"
+#include "core/atomic.h"
+#include "core/crt.h"
+#include "core/hash_map.h"
+#include "core/job_system.h"
+#include "core/math.h"
+#include "core/path.h"
+#include "core/profiler.h"
+#include "core/stream.h"
+#include "core/string.h"
+#include "core/sync.h"
+#include "engine/resource.h"
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	#include "editor/utils.h"
+#endif
+
+// shader graph resources and code generation, node GUI is compiled only without LUMIX_SHADER_GRAPH_HEADLESS
+// headless build links only core and engine, e.g. command line compiler
+
+namespace Lumix {
+
+struct FileSystem;
+struct ShaderGraphCompiler;
+struct FunctionLibrary;
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+struct StudioApp;
+#endif
+
+enum class Version {
+	FIRST,
+	VERTEX_STAGE,
+	PERMUTATIONS,
+	FUNCTION_HEADER,
+	TEXTURE_PACKING,
+	PRECISION,
+	LOD_VARIANTS,
+	STRING_TABLE,
+	BRANCH_LOWERING,
+	COST_BUDGET,
+	LAST
+};
+
+enum class ShaderResourceEditorType : u32 {
+	SURFACE,
+	PARTICLE,
+	FUNCTION
+};
+
+// serialized, do not change order
+enum class ShaderNodeType {
+	PBR,
+
+	NUMBER,
+	VEC2,
+	VEC3,
+	VEC4,
+	SAMPLE,
+	SWIZZLE,
+	TIME,
+	VERTEX_ID,
+	POSITION,
+	NORMAL,
+	UV0,
+	IF,
+	APPEND,
+	STATIC_SWITCH,
+	MIX,
+
+	SCALAR_PARAM,
+	VEC4_PARAM,
+	COLOR_PARAM,
+
+	MULTIPLY,
+	ADD,
+	SUBTRACT,
+	DIVIDE,
+
+	DOT,
+	CROSS,
+	MIN,
+	MAX,
+	POW,
+	DISTANCE,
+	
+	ABS,
+	ALL,
+	ANY,
+	CEIL,
+	COS,
+	EXP,
+	EXP2,
+	FLOOR,
+	FRACT,
+	LOG,
+	LOG2,
+	NORMALIZE,
+	NOT,
+	ROUND,
+	SATURATE,
+	SIN,
+	SQRT,
+	TAN,
+	TRANSPOSE,
+	TRUNC,
+
+	FRESNEL,
+	LENGTH,
+	VIEW_DIR,
+	PIXEL_DEPTH,
+	SCREEN_POSITION,
+	SCENE_DEPTH,
+	ONEMINUS,
+	CODE,
+	PIN,
+	BACKFACE_SWITCH,
+
+	FUNCTION_INPUT,
+	FUNCTION_OUTPUT,
+	FUNCTION_CALL,
+
+	PARTICLE_STREAM
+};
+
+// bump allocator with free lists, memory is returned to the parent only by reset() and in destructor
+// nodes and their strings are destroyed and created often (e.g. by undo), free lists make it cheap
+struct NodeAllocator final : IAllocator {
+	static constexpr u32 CHUNK_SIZE = 64 * 1024;
+	static constexpr u32 ALIGN = 16;
+	// size classes are 16, 32, ..., 4096 bytes, bigger blocks are allocated from the parent
+	static constexpr u32 SIZE_CLASSES_COUNT = 9;
+	static constexpr u32 BIG_BLOCK = 0xffFFffFF;
+
+	struct alignas(16) Header {
+		u32 size_class;
+	};
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	explicit NodeAllocator(IAllocator& parent)
+		: m_parent(parent)
+		, m_chunks(parent)
+	{}
+
+	~NodeAllocator() {
+		for (u8* chunk : m_chunks) m_parent.deallocate(chunk);
+	}
+
+	// all memory allocated from this allocator must be already deallocated
+	void reset() {
+		// keep one chunk, so the next graph does not need to allocate
+		while (m_chunks.size() > 1) {
+			m_parent.deallocate(m_chunks.back());
+			m_chunks.pop();
+		}
+		m_cursor = m_chunks.empty() ? nullptr : m_chunks[0];
+		m_end = m_chunks.empty() ? nullptr : m_chunks[0] + CHUNK_SIZE;
+		memset(m_free_lists, 0, sizeof(m_free_lists));
+	}
+
+	void* allocate(size_t size, size_t align) override {
+		ASSERT(align <= ALIGN);
+		const u32 size_class = getSizeClass(size);
+		if (size_class == BIG_BLOCK) {
+			Header* header = (Header*)m_parent.allocate(sizeof(Header) + size, ALIGN);
+			header->size_class = BIG_BLOCK;
+			return header + 1;
+		}
+
+		if (m_free_lists[size_class]) {
+			FreeBlock* block = m_free_lists[size_class];
+			m_free_lists[size_class] = block->next;
+			return block;
+		}
+
+		const u32 block_size = sizeof(Header) + (16 << size_class);
+		if (!m_cursor || m_cursor + block_size > m_end) {
+			m_cursor = (u8*)m_parent.allocate(CHUNK_SIZE, ALIGN);
+			m_end = m_cursor + CHUNK_SIZE;
+			m_chunks.push(m_cursor);
+		}
+		Header* header = (Header*)m_cursor;
+		m_cursor += block_size;
+		header->size_class = size_class;
+		return header + 1;
+	}
+
+	void deallocate(void* ptr) override {
+		if (!ptr) return;
+		Header* header = (Header*)ptr - 1;
+		if (header->size_class == BIG_BLOCK) {
+			m_parent.deallocate(header);
+			return;
+		}
+		FreeBlock* block = (FreeBlock*)ptr;
+		block->next = m_free_lists[header->size_class];
+		m_free_lists[header->size_class] = block;
+	}
+
+	void* reallocate(void* ptr, size_t new_size, size_t old_size, size_t align) override {
+		if (!ptr) return allocate(new_size, align);
+		const Header* header = (const Header*)ptr - 1;
+		if (header->size_class != BIG_BLOCK && new_size <= (16u << header->size_class)) return ptr;
+
+		void* new_ptr = allocate(new_size, align);
+		memcpy(new_ptr, ptr, minimum(old_size, new_size));
+		deallocate(ptr);
+		return new_ptr;
+	}
+
+private:
+	static u32 getSizeClass(size_t size) {
+		u32 size_class = 0;
+		while ((16u << size_class) < size) {
+			++size_class;
+			if (size_class == SIZE_CLASSES_COUNT) return BIG_BLOCK;
+		}
+		return size_class;
+	}
+
+	IAllocator& m_parent;
+	Array<u8*> m_chunks;
+	u8* m_cursor = nullptr;
+	u8* m_end = nullptr;
+	FreeBlock* m_free_lists[SIZE_CLASSES_COUNT] = {};
+};
+
+// set of node ids, one bit per id
+struct NodeIdSet {
+	explicit NodeIdSet(IAllocator& allocator) : m_bits(allocator) {}
+
+	void add(u16 id) {
+		const u32 word = id >> 6;
+		while ((u32)m_bits.size() <= word) m_bits.push(0);
+		m_bits[word] |= u64(1) << (id & 63);
+	}
+
+	bool has(u16 id) const {
+		const u32 word = id >> 6;
+		return word < (u32)m_bits.size() && (m_bits[word] & (u64(1) << (id & 63)));
+	}
+
+	bool empty() const { return m_bits.empty(); }
+
+private:
+	Array<u64> m_bits;
+};
+
+// linear allocator for temporary data of a codegen pass, deallocate does nothing (except for the last allocation)
+// reset() keeps the memory, so passes on graphs of the same size do not allocate from the parent
+struct ScratchAllocator final : IAllocator {
+	static constexpr u32 MIN_CHUNK_SIZE = 64 * 1024;
+
+	struct Chunk {
+		u8* mem;
+		u32 size;
+	};
+
+	explicit ScratchAllocator(IAllocator& parent)
+		: m_parent(parent)
+		, m_chunks(parent)
+	{}
+
+	~ScratchAllocator() {
+		for (const Chunk& chunk : m_chunks) m_parent.deallocate(chunk.mem);
+	}
+
+	// all memory allocated from this allocator must be already unused
+	void reset() {
+		if (m_chunks.size() > 1) {
+			// merge all chunks into one big enough for everything allocated since the last reset
+			u32 total = 0;
+			for (const Chunk& chunk : m_chunks) {
+				total += chunk.size;
+				m_parent.deallocate(chunk.mem);
+			}
+			m_chunks.clear();
+			m_chunks.push({(u8*)m_parent.allocate(total, 16), total});
+		}
+		m_cursor = m_chunks.empty() ? nullptr : m_chunks[0].mem;
+		m_end = m_chunks.empty() ? nullptr : m_chunks[0].mem + m_chunks[0].size;
+		m_last = nullptr;
+	}
+
+	void* allocate(size_t size, size_t align) override {
+		u8* ptr = (u8*)alignUp((uintptr)m_cursor, align);
+		if (!m_cursor || ptr + size > m_end) {
+			const u32 chunk_size = maximum(MIN_CHUNK_SIZE, u32(size + align));
+			m_cursor = (u8*)m_parent.allocate(chunk_size, 16);
+			m_end = m_cursor + chunk_size;
+			m_chunks.push({m_cursor, chunk_size});
+			ptr = (u8*)alignUp((uintptr)m_cursor, align);
+		}
+		m_cursor = ptr + size;
+		m_last = ptr;
+		return ptr;
+	}
+
+	void deallocate(void* ptr) override {
+		if (ptr && ptr == m_last) {
+			m_cursor = m_last;
+			m_last = nullptr;
+		}
+	}
+
+	void* reallocate(void* ptr, size_t new_size, size_t old_size, size_t align) override {
+		if (!ptr) return allocate(new_size, align);
+		// growing arrays and streams usually reallocate the last allocation
+		if (ptr == m_last && (u8*)ptr + new_size <= m_end) {
+			m_cursor = (u8*)ptr + new_size;
+			return ptr;
+		}
+		void* new_ptr = allocate(new_size, align);
+		memcpy(new_ptr, ptr, minimum(old_size, new_size));
+		return new_ptr;
+	}
+
+private:
+	static uintptr alignUp(uintptr value, size_t align) { return (value + align - 1) & ~(uintptr)(align - 1); }
+
+	IAllocator& m_parent;
+	Array<Chunk> m_chunks;
+	u8* m_cursor = nullptr;
+	u8* m_end = nullptr;
+	u8* m_last = nullptr;
+};
+
+#ifdef LUMIX_SHADER_GRAPH_HEADLESS
+// same data as NodeEditorLink, so editor and headless builds read and write the same files
+struct ShaderGraphLink {
+	static constexpr u32 OUTPUT_FLAG = 1 << 31;
+
+	u16 getFromNode() const { return from & 0xffFF; }
+	u16 getToNode() const { return to & 0xffFF; }
+	u16 getFromPin() const { return (from >> 16) & 0x7fff; }
+	u16 getToPin() const { return (to >> 16) & 0x7fff; }
+
+	u32 from;
+	u32 to;
+	u32 color = 0;
+};
+
+// NodeEditorNode without the GUI
+struct ShaderGraphNodeBase {
+	virtual ~ShaderGraphNodeBase() {}
+	virtual bool hasInputPins() const = 0;
+	virtual bool hasOutputPins() const = 0;
+
+	u16 m_id;
+	Vec2 m_pos = Vec2(0, 0);
+};
+#endif
+
+struct ShaderEditorResource {
+#ifdef LUMIX_SHADER_GRAPH_HEADLESS
+	using Link = ShaderGraphLink;
+	using NodeBase = ShaderGraphNodeBase;
+#else
+	using Link = NodeEditorLink;
+	using NodeBase = NodeEditorNode;
+#endif
+
+	enum class ValueType : i32 {
+		BOOL,
+		FLOAT,
+		INT,
+		VEC2,
+		VEC3,
+		VEC4,
+		IVEC4,
+
+		COUNT,
+		NONE
+	};
+
+	// value known at compile time
+	// how often can a value change, used to find values which can be computed per vertex and interpolated
+	enum class Frequency : u8 {
+		CONSTANT,
+		LINEAR, // linear in vertex attributes, interpolation gives exact per-pixel values
+		VERTEX, // can be evaluated in vertex shader, but interpolation is only an approximation
+		FRAGMENT
+	};
+
+	// precision of float temporaries, AUTO is inferred in reduced precision mode, otherwise it's full precision
+	enum class Precision : u8 {
+		AUTO,
+		LOW,
+		HIGH
+	};
+
+	struct Constant {
+		ValueType type = ValueType::NONE;
+		float value[4] = {};
+	};
+
+	// rough instruction count, transcendental ops and texture fetches are much slower than simple ALU ops
+	struct Cost {
+		static constexpr u32 TRANSCENDENTAL_WEIGHT = 4;
+		static constexpr u32 TEXTURE_WEIGHT = 8;
+
+		u32 getWeighted() const { return alu + transcendental * TRANSCENDENTAL_WEIGHT + texture * TEXTURE_WEIGHT; }
+		void add(const Cost& rhs) {
+			alu += rhs.alu;
+			transcendental += rhs.transcendental;
+			texture += rhs.texture;
+		}
+
+		u32 alu = 0;
+		u32 transcendental = 0;
+		u32 texture = 0;
+	};
+
+	struct CostEstimate {
+		Cost vertex;
+		Cost fragment;
+		// weighted cost of the most expensive node
+		u32 max_node_cost = 0;
+	};
+
+	struct Node : NodeBase {
+		Node(ShaderEditorResource& resource);
+		virtual ~Node() {}
+
+		virtual void serialize(OutputMemoryStream&blob) {}
+		virtual void deserialize(InputMemoryStream&blob) {}
+		virtual void printReference(OutputMemoryStream& blob, int output_idx) const;
+		virtual ShaderNodeType getType() const = 0;
+		virtual u32 getOutputCount() const { return hasOutputPins() ? 1 : 0; }
+
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+		bool nodeGUI() override;
+		bool isDrawnAsBox() const;
+		void inputSlot();
+		void outputSlot();
+#endif
+		bool generateOnce(OutputMemoryStream& blob);
+		// reads the type computed by ShaderEditorResource::updateTypes
+		ValueType getOutputType(int index) const;
+
+		// inlined nodes (e.g. operators) do not declare a variable, they print the whole expression in printReference
+		virtual bool isInlined() const { return false; }
+		// pure nodes with the same type, parameters and inputs generate the same code, so we can merge them
+		virtual bool isPure() const { return true; }
+		// evaluates the node at compile time, inputs are already folded if possible
+		virtual bool fold(Constant& result) const { return false; }
+		// replaces the node with one of its inputs, e.g. x * 1 -> x
+		virtual bool simplify(Node*& alias, u16& alias_output) const { return false; }
+		// cost of the code generated by this node, without its inputs
+		virtual Cost estimateCost() const;
+
+		bool m_selected = false;
+		bool m_reachable = false;
+		bool m_generated = false;
+		// codegen state, valid only during ShaderEditorResource::generate
+		// inlined expression was stored in a variable, reference it by the name
+		bool m_hoisted = false;
+		// number of links from reachable nodes using this node's outputs
+		u32 m_use_count = 0;
+		// identical node, which is generated instead of this one
+		Node* m_alias = nullptr;
+		// output of m_alias to use, -1 if it's the same as output of this node
+		i32 m_alias_output = -1;
+		// used by the code of the variant being generated, i.e. reachable after merging, folding and pruning
+		bool m_live = false;
+		// m_constant is printed instead of any code
+		bool m_folded = false;
+		Constant m_constant;
+		// computed in vertex shader and passed to fragment shader as v_vs<id>, set by user
+		bool m_vertex_stage = false;
+		// set by user, serialized in node flags
+		Precision m_precision = Precision::AUTO;
+		// set by user, replaced by a constant in reduced LOD, serialized in node flags
+		bool m_lod_optional = false;
+		// codegen state, folded away in reduced LOD, outputs of PBR node connected to it use their defaults
+		bool m_lod_dropped = false;
+		// codegen state, declared as mediump
+		bool m_low_precision = false;
+		// codegen state, value is read from varying in fragment shader
+		bool m_interpolated = false;
+		Frequency m_frequency = Frequency::FRAGMENT;
+		// set by ShaderEditorResource::estimateCost
+		Cost m_cost;
+		u32 m_input_count = 0;
+		u32 m_output_count = 0;
+
+		ShaderEditorResource& m_resource;
+		String m_error;
+		// index of the link connected to each input pin, -1 if the pin is not connected
+		Array<i32> m_input_links;
+		// indices of all links going out of this node
+		Array<u32> m_output_links;
+		// output types inferred by ShaderEditorResource::updateTypes
+		Array<ValueType> m_output_types;
+		u8 m_visit_state = 0;
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+		struct CachedPin {
+			u32 id;
+			// relative to the top left corner of the node's content
+			ImVec2 offset;
+			bool is_input;
+		};
+		// layout from the last full draw, off-screen or zoomed out nodes draw only a box of this size with pins, so links stay attached
+		Array<CachedPin> m_cached_pins;
+		ImVec2 m_cached_size = ImVec2(0, 0);
+		bool m_layout_valid = false;
+		// set while drawing, pins are relative to it
+		ImVec2 m_content_origin = ImVec2(0, 0);
+#endif
+
+	protected:
+		friend struct ShaderEditorResource;
+		// called only from ShaderEditorResource::updateTypes, inputs have their types already computed
+		virtual ValueType computeOutputType(int index) const { return ValueType::FLOAT; }
+		virtual bool generate(OutputMemoryStream& blob) { return true; }
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+		virtual bool onGUI() = 0;
+#endif
+		bool error(const char* msg) { m_error = msg; return false; }
+	};
+
+	ShaderEditorResource(const Path& path, ShaderGraphCompiler& compiler, IAllocator& allocator)
+		: m_compiler(compiler)
+		, m_allocator(allocator)
+		, m_node_allocator(allocator)
+		, m_scratch(allocator)
+		, m_links(m_allocator)
+		, m_nodes(m_allocator)
+		, m_node_map(m_allocator)
+		, m_permutation_defines(m_allocator)
+		, m_variants(m_allocator)
+		, m_function_inputs(m_allocator)
+		, m_packed_textures(m_allocator)
+		, m_particle_streams(m_allocator)
+		, m_texture_fetches(m_allocator)
+		, m_path(path)
+	{}
+
+	~ShaderEditorResource() {
+		for (auto* node : m_nodes) {
+			LUMIX_DELETE(m_node_allocator, node);
+		}
+	}
+
+	bool load();
+
+	template <typename F>
+	static void	forEachInput(const ShaderEditorResource& resource, int node_id, const F& f) {
+		const Node* node = resource.getNode(node_id);
+		if (!node) return;
+		for (u32 i = 0, c = node->m_input_links.size(); i < c; ++i) {
+			const i32 link_idx = node->m_input_links[i];
+			if (link_idx < 0) continue;
+			const ShaderEditorResource::Link& link = resource.m_links[link_idx];
+			ShaderEditorResource::Node* from = resource.getNode(link.getFromNode());
+			f(from, link.getFromPin(), link.getToPin(), u32(link_idx));
+		}
+	}
+
+	// makes sure m_node_map and per-node link indices match m_nodes and m_links
+	// node editor adds and removes links directly in m_links, so we detect that by the links count
+	// links replaced in place are not detected, the editor invalidates the index after each edit
+	void updateLinkIndex() const {
+		if (!m_link_index_dirty && m_indexed_links_count == (u32)m_links.size()) return;
+
+		m_node_map.clear();
+		for (Node* n : m_nodes) {
+			n->m_input_links.clear();
+			n->m_output_links.clear();
+			m_node_map.insert(n->m_id, n);
+		}
+		for (u32 i = 0, c = m_links.size(); i < c; ++i) indexLink(i);
+		m_indexed_links_count = m_links.size();
+		m_link_index_dirty = false;
+		m_types_dirty = true;
+	}
+
+	void invalidateLinkIndex() { m_link_index_dirty = true; }
+
+	Node* getNode(u16 id) const {
+		updateLinkIndex();
+		auto iter = m_node_map.find(id);
+		return iter.isValid() ? iter.value() : nullptr;
+	}
+
+	// returns index of link connected to input `pin` of `node`, -1 if there's none
+	i32 getInputLink(const Node& node, u16 pin) const {
+		updateLinkIndex();
+		if (pin >= (u32)node.m_input_links.size()) return -1;
+		return node.m_input_links[pin];
+	}
+
+	void addNode(Node* node) {
+		updateLinkIndex();
+		m_nodes.push(node);
+		m_node_map.insert(node->m_id, node);
+		m_types_dirty = true;
+	}
+
+	void insertNode(Node* node, u32 index) {
+		updateLinkIndex();
+		m_nodes.insert(index, node);
+		m_node_map.insert(node->m_id, node);
+		m_types_dirty = true;
+	}
+
+	// `node` takes place of `old`, including links, `old` is destroyed
+	void replaceNode(Node* old, Node* node) {
+		ASSERT(old->m_id == node->m_id);
+		m_nodes[m_nodes.indexOf(old)] = node;
+		m_node_map.erase(old->m_id);
+		m_node_map.insert(node->m_id, node);
+		LUMIX_DELETE(m_node_allocator, old);
+		invalidateLinkIndex();
+		m_types_dirty = true;
+	}
+
+	void addLink(const Link& link) {
+		updateLinkIndex();
+		m_links.push(link);
+		indexLink(m_links.size() - 1);
+		m_indexed_links_count = m_links.size();
+		m_types_dirty = true;
+	}
+
+	// does not preserve order of links
+	void removeLink(u32 link_idx) {
+		updateLinkIndex();
+		unindexLink(link_idx);
+		const u32 last = m_links.size() - 1;
+		if (link_idx != last) {
+			unindexLink(last);
+			m_links[link_idx] = m_links[last];
+			m_links.pop();
+			indexLink(link_idx);
+		}
+		else {
+			m_links.pop();
+		}
+		m_indexed_links_count = m_links.size();
+		m_types_dirty = true;
+	}
+
+	// iterative DFS, `order` contains nodes in such order that each node comes after nodes connected to its inputs
+	void computeTopologicalOrder(Array<Node*>& order) const {
+		enum : u8 { NOT_VISITED, OPEN, CLOSED };
+		updateLinkIndex();
+		order.clear();
+		order.reserve(m_nodes.size());
+		for (Node* n : m_nodes) n->m_visit_state = NOT_VISITED;
+
+		struct StackItem {
+			Node* node;
+			u32 pin;
+		};
+		Array<StackItem> stack(order.getAllocator());
+		for (Node* root : m_nodes) {
+			if (root->m_visit_state != NOT_VISITED) continue;
+			root->m_visit_state = OPEN;
+			stack.push({root, 0});
+			while (!stack.empty()) {
+				StackItem& item = stack.back();
+				Node* node = item.node;
+				if (item.pin < (u32)node->m_input_links.size()) {
+					const i32 link_idx = node->m_input_links[item.pin];
+					++item.pin;
+					if (link_idx < 0) continue;
+					Node* from = getNode(m_links[link_idx].getFromNode());
+					// OPEN means there's a cycle, we just ignore the link
+					if (!from || from->m_visit_state != NOT_VISITED) continue;
+					from->m_visit_state = OPEN;
+					stack.push({from, 0});
+					continue;
+				}
+				node->m_visit_state = CLOSED;
+				order.push(node);
+				stack.pop();
+			}
+		}
+	}
+
+	void invalidateTypes() { m_types_dirty = true; }
+
+	// infers types of all outputs in one pass, called lazily after any change to the graph
+	void updateTypes() const {
+		updateLinkIndex();
+		if (!m_types_dirty) return;
+		m_types_dirty = false;
+
+		Array<Node*> order(m_allocator);
+		computeTopologicalOrder(order);
+		for (Node* n : order) n->m_output_types.clear();
+		for (Node* n : order) {
+			const u32 count = n->getOutputCount();
+			n->m_output_types.reserve(count);
+			for (u32 i = 0; i < count; ++i) {
+				n->m_output_types.push(n->computeOutputType(i));
+			}
+		}
+	}
+
+	// removes all links from and to `node`
+	void unlinkNode(Node& node) {
+		updateLinkIndex();
+		while (!node.m_output_links.empty()) removeLink(node.m_output_links.back());
+		for (u32 i = 0; i < (u32)node.m_input_links.size(); ++i) {
+			if (node.m_input_links[i] >= 0) removeLink(node.m_input_links[i]);
+		}
+	}
+
+	// marks nodes reachable from the output and colors links by the output pin they lead to, in one pass
+	// each node is visited once, links upstream of several output pins get color of the highest pin
+	void markReachableNodes() {
+		// ABGR, the same as IM_COL32, so it does not depend on imgui
+		const u32 colors[] = {
+			0xFFA02020,
+			0xFF20A020,
+			0xFFA0A020,
+			0xFF2020A0,
+			0xFFA020A0,
+			0xFF20A0A0,
+			0xFFA0A0A0,
+		};
+
+		updateLinkIndex();
+		for (Node* n : m_nodes) n->m_reachable = false;
+		for (Link& l : m_links) l.color = 0xFFA0A0A0;
+
+		struct StackItem {
+			Node* node;
+			u32 color;
+		};
+		Array<StackItem> stack(m_allocator);
+		Node* output = m_nodes[0];
+		output->m_reachable = true;
+		for (i32 pin = output->m_input_links.size() - 1; pin >= 0; --pin) {
+			const i32 root_link = output->m_input_links[pin];
+			if (root_link < 0) continue;
+			const u32 color = colors[pin % lengthOf(colors)];
+			m_links[root_link].color = color;
+			Node* root = getNode(m_links[root_link].getFromNode());
+			if (!root || root->m_reachable) continue;
+			root->m_reachable = true;
+			stack.push({root, color});
+			while (!stack.empty()) {
+				const StackItem item = stack.back();
+				stack.pop();
+				for (i32 link_idx : item.node->m_input_links) {
+					if (link_idx < 0) continue;
+					m_links[link_idx].color = item.color;
+					Node* from = getNode(m_links[link_idx].getFromNode());
+					if (!from || from->m_reachable) continue;
+					from->m_reachable = true;
+					stack.push({from, item.color});
+				}
+			}
+		}
+	}
+
+	void clearGeneratedFlags() {
+		for (Node* n : m_nodes) n->m_generated = false;
+	}
+
+	void destroyNode(Node* node) {
+		unlinkNode(*node);
+		m_node_map.erase(node->m_id);
+		m_nodes.eraseItem(node);
+		LUMIX_DELETE(m_node_allocator, node);
+		m_types_dirty = true;
+	}
+
+	void clear() {
+		m_last_node_id = 0;
+		m_links.clear();
+		for (Node* n : m_nodes) {
+			LUMIX_DELETE(m_node_allocator, n);
+		}
+		m_nodes.clear();
+		m_node_map.clear();
+		m_node_allocator.reset();
+		m_link_index_dirty = true;
+		m_types_dirty = true;
+	}
+
+	// destroys nodes in `doomed` and their links in one pass, order of remaining nodes and links is preserved
+	// output node (m_nodes[0]) is never destroyed
+	void destroyNodes(const NodeIdSet& doomed) {
+		if (doomed.empty()) return;
+		u32 links_count = 0;
+		for (u32 i = 0, c = m_links.size(); i < c; ++i) {
+			const Link& link = m_links[i];
+			if (doomed.has(link.getFromNode()) || doomed.has(link.getToNode())) continue;
+			m_links[links_count] = link;
+			++links_count;
+		}
+		while ((u32)m_links.size() > links_count) m_links.pop();
+
+		u32 nodes_count = m_nodes.empty() ? 0 : 1;
+		for (u32 i = 1, c = m_nodes.size(); i < c; ++i) {
+			Node* node = m_nodes[i];
+			if (doomed.has(node->m_id)) {
+				m_node_map.erase(node->m_id);
+				LUMIX_DELETE(m_node_allocator, node);
+				continue;
+			}
+			m_nodes[nodes_count] = node;
+			++nodes_count;
+		}
+		while ((u32)m_nodes.size() > nodes_count) m_nodes.pop();
+
+		invalidateLinkIndex();
+		m_types_dirty = true;
+	}
+
+	void deleteSelectedNodes() {
+		NodeIdSet doomed(m_allocator);
+		// we really don't want to delete node 0 (output)
+		for (u32 i = 1, c = m_nodes.size(); i < c; ++i) {
+			if (m_nodes[i]->m_selected) doomed.add(m_nodes[i]->m_id);
+		}
+		destroyNodes(doomed);
+	}
+	
+	void deleteUnreachable() {
+		markReachableNodes();
+		NodeIdSet doomed(m_allocator);
+		for (Node* node : m_nodes) {
+			if (!node->m_reachable) doomed.add(node->m_id);
+		}
+		destroyNodes(doomed);
+	}
+
+	void indexLink(u32 link_idx) const {
+		const Link& link = m_links[link_idx];
+		auto to_iter = m_node_map.find(link.getToNode());
+		auto from_iter = m_node_map.find(link.getFromNode());
+		if (!to_iter.isValid() || !from_iter.isValid()) return;
+
+		Node* to = to_iter.value();
+		const u16 pin = link.getToPin();
+		while ((u32)to->m_input_links.size() <= pin) to->m_input_links.push(-1);
+		to->m_input_links[pin] = link_idx;
+		from_iter.value()->m_output_links.push(link_idx);
+	}
+
+	void unindexLink(u32 link_idx) const {
+		const Link& link = m_links[link_idx];
+		auto to_iter = m_node_map.find(link.getToNode());
+		auto from_iter = m_node_map.find(link.getFromNode());
+		if (to_iter.isValid()) {
+			Node* to = to_iter.value();
+			const u16 pin = link.getToPin();
+			if (pin < (u32)to->m_input_links.size() && to->m_input_links[pin] == (i32)link_idx) {
+				to->m_input_links[pin] = -1;
+			}
+			else {
+				// multiple links to one pin, let the index be rebuilt
+				m_link_index_dirty = true;
+			}
+		}
+		if (from_iter.isValid()) from_iter.value()->m_output_links.eraseItem(link_idx);
+	}
+
+	// bit 0 - vertex stage, bits 1-2 - precision, bit 3 - LOD optional
+	static u8 getNodeFlags(const Node& node) { return (node.m_vertex_stage ? 1 : 0) | (u8(node.m_precision) << 1) | (node.m_lod_optional ? 8 : 0); }
+	static void setNodeFlags(Node& node, u8 flags) {
+		node.m_vertex_stage = flags & 1;
+		node.m_precision = Precision((flags >> 1) & 3);
+		node.m_lod_optional = flags & 8;
+	}
+
+	static void serializeNode(OutputMemoryStream& blob, Node& node) {
+		int type = (int)node.getType();
+		blob.write(node.m_id);
+		blob.write(type);
+		blob.write(node.m_pos);
+		blob.write(getNodeFlags(node));
+
+		node.serialize(blob);
+	}
+	
+	Node& deserializeNode(InputMemoryStream& blob) {
+		int type;
+		u16 id;
+		blob.read(id);
+		blob.read(type);
+		Node* node = createNode(type);
+		node->m_id = id;
+		addNode(node);
+		blob.read(node->m_pos);
+		if (m_version > Version::VERTEX_STAGE) {
+			u8 flags;
+			blob.read(flags);
+			setNodeFlags(*node, flags);
+		}
+
+		node->deserialize(blob);
+		return *node;
+	}
+
+	bool generate(String* source) {
+		PROFILE_FUNCTION();
+		profiler::pushString(m_path.c_str());
+		// types of function calls depend on other resources, so we don't trust the cache here
+		invalidateTypes();
+		updateTypes();
+		markReachableNodes();
+
+		m_scratch.reset();
+		m_texture_fetches.clear();
+		OutputMemoryStream blob(m_scratch);
+		blob.reserve(32 * 1024);
+
+		for (Node* n : m_nodes) n->m_error = "";
+		collectVariants();
+		const u32 eliminated = prepareVariant(0);
+		// each variant is folded on its own, a node eliminated in more than one variant is counted in each of them
+		m_eliminated_nodes_count = 0;
+		if (m_permuting) {
+			for (const Variant& v : m_variants) m_eliminated_nodes_count += v.eliminated_nodes_count;
+		}
+		else {
+			m_eliminated_nodes_count = eliminated;
+		}
+		const bool success = m_nodes[0]->generateOnce(blob);
+		// aliases must not outlive the codegen, nodes can be deleted in the editor
+		for (Node* n : m_nodes) n->m_alias = nullptr;
+		profiler::pushInt("nodes", m_nodes.size());
+		profiler::pushInt("links", m_links.size());
+		profiler::pushInt("bytes", (i32)blob.size());
+		if (!success) return false;
+		m_compiler.m_stats.emitted_bytes.add((i64)blob.size());
+
+		if (source) {
+			source->resize((u32)blob.size());
+			memcpy(source->getMutableData(), blob.data(), source->length());
+			source->getMutableData()[source->length()] = '\0';
+		}
+		return true;
+	}
+
+	void serialize(OutputMemoryStream& blob) {
+		blob.reserve(4096);
+		blob.write(u32('_LSE'));
+		blob.write(Version::LAST);
+
+		// function signature, so calls can be created without deserializing the whole graph
+		OutputMemoryStream header(m_allocator);
+		if (getShaderType() == ShaderResourceEditorType::FUNCTION) {
+			updateSignature();
+			writeSignature(header);
+		}
+		blob.write((u32)header.size());
+		blob.write(header.data(), header.size());
+
+		blob.write(m_last_node_id);
+
+		// nodes reference strings by index, so the table is written before them
+		StringTableWriter strings(m_allocator);
+		OutputMemoryStream nodes(m_allocator);
+		nodes.reserve(4096);
+		m_string_writer = &strings;
+		const i32 nodes_count = m_nodes.size();
+		nodes.write(nodes_count);
+		for(auto* node : m_nodes) {
+			serializeNode(nodes, *node);
+		}
+		m_string_writer = nullptr;
+
+		blob.write(strings.strings.size());
+		for (const char* str : strings.strings) blob.writeString(str);
+		blob.write(nodes.data(), nodes.size());
+
+		// sorted by destination, so inputs of a node are adjacent and in pin order
+		updateLinkIndex();
+		Array<bool> written(m_allocator);
+		written.resize(m_links.size());
+		for (bool& w : written) w = false;
+		const i32 links_count = m_links.size();
+		blob.write(links_count);
+		auto write_link = [&](u32 link_idx) {
+			blob.write(m_links[link_idx].from);
+			blob.write(m_links[link_idx].to);
+			written[link_idx] = true;
+		};
+		for (Node* n : m_nodes) {
+			for (i32 link_idx : n->m_input_links) {
+				if (link_idx >= 0) write_link(link_idx);
+			}
+		}
+		// dangling links
+		for (u32 i = 0, c = m_links.size(); i < c; ++i) {
+			if (!written[i]) write_link(i);
+		}
+	}
+
+	bool deserialize(InputMemoryStream& blob) {
+		PROFILE_FUNCTION();
+		Version version;
+		u32 magic;
+		blob.read(magic);
+		if (magic != '_LSE') return false;
+		blob.read(version);
+		if (version > Version::LAST) return false;
+		m_version = version;
+		if (version > Version::FUNCTION_HEADER) {
+			// signature is recomputed from the nodes
+			u32 header_size;
+			blob.read(header_size);
+			blob.skip(header_size);
+		}
+		blob.read(m_last_node_id);
+
+		// strings point directly into the blob, nodes copy only those they keep
+		Array<const char*> strings(m_allocator);
+		if (version > Version::STRING_TABLE) {
+			u32 strings_count;
+			blob.read(strings_count);
+			strings.reserve(strings_count);
+			for (u32 i = 0; i < strings_count; ++i) strings.push(blob.readString());
+			m_string_reader = &strings;
+		}
+		m_string_table_error = false;
+
+		int size;
+		blob.read(size);
+		m_nodes.reserve(m_nodes.size() + size);
+		for(int i = 0; i < size; ++i) {
+			deserializeNode(blob);
+		}
+		m_string_reader = nullptr;
+		// corrupted file, callers log the error, nothing of it is kept
+		if (m_string_table_error) {
+			clear();
+			return false;
+		}
+
+		blob.read(size);
+		m_links.resize(size);
+		for (Link& l : m_links) {
+			blob.read(l.from);
+			blob.read(l.to);
+		}
+		profiler::pushInt("nodes", m_nodes.size());
+		profiler::pushInt("links", m_links.size());
+		invalidateLinkIndex();
+		updateLinkIndex();
+		markReachableNodes();
+		if (!m_nodes.empty() && getShaderType() == ShaderResourceEditorType::FUNCTION) updateSignature();
+
+		return true;
+	}
+
+	// nodes must use these for their strings, so the strings end up in the string table when serializing the whole graph
+	// undo and hashing serialize single nodes, strings are inline there
+	void writeString(OutputMemoryStream& blob, const char* str) const {
+		if (m_string_writer) blob.write(m_string_writer->add(str));
+		else blob.writeString(str);
+	}
+
+	// invalid index sets m_string_table_error, deserialize fails then
+	const char* readString(InputMemoryStream& blob) {
+		if (!m_string_reader) return blob.readString();
+		u32 idx;
+		blob.read(idx);
+		if (idx < (u32)m_string_reader->size()) return (*m_string_reader)[idx];
+		m_string_table_error = true;
+		return "";
+	}
+
+	// inputs and output type of a function graph
+	void updateSignature();
+
+	void writeSignature(OutputMemoryStream& blob) const {
+		blob.write(m_function_output_type);
+		blob.write(m_function_inputs.size());
+		for (const FunctionInput& input : m_function_inputs) {
+			blob.writeString(input.name.c_str());
+			blob.write(input.type);
+		}
+	}
+
+	void readSignature(InputMemoryStream& blob) {
+		m_function_inputs.clear();
+		blob.read(m_function_output_type);
+		i32 count;
+		blob.read(count);
+		for (i32 i = 0; i < count; ++i) {
+			const char* name = blob.readString();
+			ValueType type;
+			blob.read(type);
+			m_function_inputs.emplace(name, type, m_allocator);
+		}
+	}
+
+	// expressions of inlined nodes longer than this are stored in a variable even if used only once
+	static constexpr u32 MAX_INLINED_EXPRESSION_LENGTH = 64;
+
+	// static switches are evaluated at compile time if there are at most this many of them, LOD_DEFINE is counted too
+	// with more static switches only LOD_DEFINE is evaluated at compile time
+	static constexpr u32 MAX_PERMUTATION_DEFINES = 6;
+	// part of content hash, so sources cached by an older version are not used
+	// bump it in every change which makes the same graph generate different code, e.g. new passes, different declaration order
+	static constexpr u32 CODEGEN_VERSION = 9;
+
+	// deduplicates strings of nodes, strings must outlive the writer
+	struct StringTableWriter {
+		StringTableWriter(IAllocator& allocator) : strings(allocator), map(allocator) {}
+		u32 add(const char* str);
+
+		Array<const char*> strings;
+		HashMap<u64, u32> map;
+	};
+
+	// permutations of static switches which produce the same pruned graph
+	struct Variant {
+		Variant(IAllocator& allocator) : masks(allocator) {}
+		u64 hash = 0;
+		Array<u32> masks;
+		// nodes which do not generate any code in this variant thanks to folding
+		u32 eliminated_nodes_count = 0;
+	};
+
+	void writeCodegenSignature(Node& node, OutputMemoryStream& blob) const;
+	void mergeIdenticalNodes();
+	// returns number of nodes which do not generate any code thanks to folding
+	u32 foldConstants();
+	// true while preparing the permutation with LOD_DEFINE defined
+	bool isLodReduced() const;
+	void markLiveNodes();
+	void countUses();
+	// live nodes used only through input `pin` of `node`, i.e. needed only if the node's branch for that pin is taken
+	// `uniform` - the branch is taken by all invocations or none, e.g. #ifdef, so texture fetches can be inside
+	void collectBranchNodes(const Node& node, u16 pin, bool uniform, Array<Node*>& nodes) const;
+	// sets Node::m_low_precision of live nodes in reduced precision mode
+	void inferPrecision();
+	// runs all passes before the actual codegen, returns number of nodes eliminated by folding
+	u32 prepareCodegen();
+	u32 prepareVariant(u32 variant_idx);
+	// fills m_variants, there's always at least one variant
+	void collectVariants();
+	u64 hashLiveGraph() const;
+	// writes preprocessor condition, which is true for any permutation of the variant
+	void writeVariantCondition(u32 variant_idx, OutputMemoryStream& blob) const;
+	Node* createNode(int type);
+	void init(ShaderResourceEditorType type);
+	ShaderResourceEditorType getShaderType() const;
+	ValueType getFunctionOutputType() const;
+	// returns nullptr if the function can not be loaded, returned function might have only its signature loaded
+	ShaderEditorResource* findFunction(const Path& path);
+	// deserializes functions loaded lazily by FunctionLibrary, including functions they call
+	bool ensureLoaded();
+	// node types are private to shader_graph.cpp, editor accesses their data through these
+	static ShaderEditorResource* getCalledFunction(const Node& node);
+	static void setCalledFunction(Node& node, ShaderEditorResource* fn);
+	static void setParticleStream(Node& node, u32 stream);
+	const Array<String>& getParticleAttributes() const;
+	// hash of everything affecting generated code, i.e. without node positions, selection, link colors, ...
+	u64 computeContentHash() const;
+	// `hashes` - content hashes of functions by path hash, so each function called more than once is hashed once
+	u64 computeContentHash(HashMap<u64, u64>& hashes) const;
+	// assigns single channel masks sampled with the same UV to channels of packed textures, fills m_packed_textures
+	// does nothing if texture packing is disabled on the output node
+	void packTextureMasks();
+	// lists source textures of each channel of packed textures, for the texture pipeline
+	void writePackingManifest(OutputMemoryStream& blob) const;
+	// lists particle streams and components read by the material, so the particle system can upload only those
+	void writeParticleStreamsManifest(OutputMemoryStream& blob) const;
+	// static estimate of reachable nodes, a node is counted in each stage which needs its value
+	// fills Node::m_cost and m_cost_estimate
+	void estimateCost();
+	// weighted fragment cost the graph must not exceed, 0 if there's no budget
+	u32 getCostBudget() const;
+	// estimates cost and logs an error if the graph is over its budget, bakes fail on such graphs
+	bool checkCostBudget();
+	// one JSON object per line, keyed by content hash, so reports of different revisions can be diffed
+	void writeCostReport(OutputMemoryStream& blob);
+
+	IAllocator& m_allocator;
+	// nodes and everything they own
+	NodeAllocator m_node_allocator;
+	// temporary data of generate(), reset at its beginning
+	mutable ScratchAllocator m_scratch;
+	ShaderGraphCompiler& m_compiler;
+	// functions called from this graph, compiler's library if null
+	FunctionLibrary* m_function_library = nullptr;
+	Path m_path;
+	Array<Link> m_links;
+	Array<Node*> m_nodes;
+	int m_last_node_id = 0;
+	// version of the file being deserialized
+	Version m_version = Version::LAST;
+	mutable HashMap<u16, Node*> m_node_map;
+	mutable u32 m_indexed_links_count = 0;
+	mutable bool m_link_index_dirty = true;
+	mutable bool m_types_dirty = true;
+	// statistics of the last generate(), summed over all variants
+	u32 m_eliminated_nodes_count = 0;
+	struct PackedTexture {
+		explicit PackedTexture(IAllocator& allocator) : name(allocator), sources(allocator) {}
+		// texture slot name
+		String name;
+		// slot name of the texture stored in each channel
+		Array<String> sources;
+		// channel of the source texture, e.g. 'x'
+		char source_channels[4] = {};
+	};
+	Array<PackedTexture> m_packed_textures;
+	// particle streams the material reads, i.e. the reduced vertex declaration, filled by generate()
+	// position is always included, since the vertex shader needs it
+	struct ParticleStream {
+		explicit ParticleStream(IAllocator& allocator) : name(allocator) {}
+		String name;
+		u32 stream = 0;
+		// bit i is set if i-th component is read
+		u8 mask = 0;
+	};
+	Array<ParticleStream> m_particle_streams;
+	// codegen state, texture fetches already emitted in the current shader stage, keyed by texture and UV expression
+	HashMap<u64, Node*> m_texture_fetches;
+	// codegen state, number of branches and #ifdef arms the code being emitted is nested in, variables declared there are not visible outside
+	u32 m_branch_depth = 0;
+	CostEstimate m_cost_estimate;
+	// nodes are tinted by their cost
+	bool m_show_cost_heatmap = false;
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	// nodes are drawn as empty boxes, set by the editor when zoomed out
+	bool m_simplified_canvas = false;
+	// screen position of canvas origin, taken from the last fully drawn node, so culled nodes know where they are
+	ImVec2 m_canvas_origin = ImVec2(0, 0);
+#endif
+	// breaks recursion of functions calling each other
+	bool m_estimating_cost = false;
+	// sorted names of static switches, bit i of a permutation mask is set if i-th define is defined
+	Array<String> m_permutation_defines;
+	Array<Variant> m_variants;
+	u32 m_permutation_mask = 0;
+	// static switches are replaced by their inputs according to m_permutation_mask
+	bool m_permuting = false;
+	// set only while (de)serializing the whole graph, see writeString and readString
+	StringTableWriter* m_string_writer = nullptr;
+	const Array<const char*>* m_string_reader = nullptr;
+	bool m_string_table_error = false;
+	// defined by materials of lower LODs, LOD-optional nodes are dropped in its permutation
+	static constexpr const char* LOD_DEFINE = "LOD_REDUCED";
+
+	struct FunctionInput {
+		FunctionInput(const char* name, ValueType type, IAllocator& allocator) : name(name, allocator), type(type) {}
+		String name;
+		ValueType type;
+	};
+	// signature of a function graph, valid even if only the header of the file is loaded
+	Array<FunctionInput> m_function_inputs;
+	ValueType m_function_output_type = ValueType::NONE;
+
+	enum class LoadState : i32 {
+		// known only by path
+		EMPTY,
+		// signature is not available yet, it's being read or the whole file is deserialized if it has no header
+		OPENING,
+		// only the header is loaded
+		SIGNATURE,
+		PARSING,
+		// nodes are loaded, but called functions are not
+		PARSED,
+		// called functions are being loaded
+		RESOLVING,
+		LOADED,
+		FAILED
+	};
+	// functions in FunctionLibrary are loaded lazily, other resources are always LOADED
+	AtomicI32 m_load_state{(i32)LoadState::LOADED};
+	// red while the function is OPENING, PARSING or RESOLVING, changed together with m_load_state with FunctionLibrary::m_mutex locked
+	jobs::Signal m_loading;
+
+	static ResourceType TYPE;
+};
+
+
+// function graphs by path hash, pointers to functions stay valid until the library is destroyed
+// calls need only the signature from the file's header, the rest is deserialized on first use, in background if `async`
+// compile jobs use their own library, so they do not share any mutable state with other jobs or the editor
+struct FunctionLibrary {
+	using LoadState = ShaderEditorResource::LoadState;
+
+	FunctionLibrary(ShaderGraphCompiler& compiler, IAllocator& allocator, bool async)
+		: m_compiler(compiler)
+		, m_allocator(allocator)
+		, m_async(async)
+		, m_functions(allocator)
+	{}
+
+	~FunctionLibrary();
+
+	// makes the function known without reading it, already used function is reloaded in place, since nodes point to it
+	void add(const Path& path);
+	// `wait_for_signature` is false while deserializing other functions, they might be the ones still opening
+	ShaderEditorResource* find(const Path& path, bool wait_for_signature);
+	// blocks until `fn` and all functions it calls are deserialized, fails if any of them fails
+	// functions calling each other recursively fail, calls are never changed
+	bool ensureLoaded(ShaderEditorResource& fn);
+	// m_resolve_mutex must be locked, `stack` - functions being resolved, `recursive` - functions found in a call cycle
+	bool ensureLoaded(ShaderEditorResource& fn, Array<ShaderEditorResource*>& stack, Array<ShaderEditorResource*>& recursive);
+	// `fn` must be OPENING, reads its signature and parses the rest in background, or parses everything now
+	void open(ShaderEditorResource& fn);
+	// reads only the header, false if there's none, e.g. file from an older version
+	bool readSignature(ShaderEditorResource& fn);
+	// `fn` must be OPENING or PARSING
+	void parse(ShaderEditorResource& fn);
+	static void parseJob(void* data);
+	// changes state of `fn` from `from` to OPENING, PARSING or RESOLVING, false if it's not in `from` state
+	bool beginLoading(ShaderEditorResource& fn, LoadState from, LoadState to);
+	// changes state of `fn` from OPENING, PARSING or RESOLVING to `state` and wakes up threads waiting for it
+	void endLoading(ShaderEditorResource& fn, LoadState state);
+	// blocks while `fn` is OPENING, or PARSING and RESOLVING too if `parsing` is true
+	static void waitLoading(ShaderEditorResource& fn, bool parsing);
+
+	ShaderGraphCompiler& m_compiler;
+	IAllocator& m_allocator;
+	bool m_async;
+	Mutex m_mutex;
+	// calls are resolved by one thread at a time, so threads resolving functions which call each other do not wait for each other
+	Mutex m_resolve_mutex;
+	HashMap<u64, ShaderEditorResource*> m_functions;
+	jobs::Counter m_parse_jobs;
+};
+
+// generates code of shader graphs, shared by the studio plugin and the command line compiler
+struct ShaderGraphCompiler {
+	// writeFunctions fails if functions are invalidated by this many edits while it runs
+	static constexpr u32 MAX_FUNCTION_COMPILE_ATTEMPTS = 4;
+
+	// generated code of a function graph, shared by all shaders calling it
+	struct CompiledFunction {
+		CompiledFunction(const Path& path, u64 key, IAllocator& allocator)
+			: path(path)
+			, key(key)
+			, code(allocator)
+			, dependencies(allocator)
+		{}
+
+		Path path;
+		// path + content hash
+		u64 key;
+		String code;
+		// keys of all functions called by this one, directly or indirectly, callees first
+		Array<u64> dependencies;
+	};
+
+	// totals since the compiler was created, updated from compile jobs
+	struct Stats {
+		AtomicI32 compiled_graphs{0};
+		AtomicI32 failed_graphs{0};
+		// generated sources cached on disk by the editor
+		AtomicI32 source_cache_hits{0};
+		AtomicI32 source_cache_misses{0};
+		AtomicI32 function_cache_hits{0};
+		AtomicI32 function_cache_misses{0};
+		AtomicI64 emitted_bytes{0};
+		AtomicI64 compile_time_us{0};
+		// so the time can be attributed to a graph, guarded by ShaderGraphCompiler::m_stats_mutex
+		Path slowest_graph;
+		float slowest_graph_time = 0;
+	};
+
+	// `async_functions` - function graphs are deserialized by background jobs
+	ShaderGraphCompiler(FileSystem& fs, IAllocator& allocator, bool async_functions);
+	~ShaderGraphCompiler();
+
+	// registers a new function or reloads an existing one
+	void addFunction(const Path& path);
+	// writes code of `functions` and of all functions they call, callees first, each function once
+	bool writeFunctions(Span<ShaderEditorResource* const> functions, OutputMemoryStream& blob);
+	// returns false if `fn` or any function it calls fails to generate, `order` is extended by keys of generated functions
+	// `hashes` - see ShaderEditorResource::computeContentHash
+	bool compileFunction(ShaderEditorResource& fn, Array<u64>& order, HashMap<u64, u64>& hashes);
+	// removes cached code of the function and of all functions calling it
+	void invalidateCompiledFunction(const Path& path);
+	// updates m_stats and profiler counters, `time` is in seconds
+	void onGraphCompiled(const Path& path, bool success, float time);
+
+	IAllocator& m_allocator;
+	FileSystem& m_fs;
+	FunctionLibrary m_function_library;
+	// compile jobs share generated functions, access only with m_compiled_functions_mutex locked
+	// functions are generated without the lock, each job generates its own function resources, entries are only looked up and inserted with it
+	Mutex m_compiled_functions_mutex;
+	HashMap<u64, CompiledFunction*> m_compiled_functions;
+	Stats m_stats;
+	Mutex m_stats_mutex;
+	u32 m_compile_time_counter;
+#ifndef LUMIX_SHADER_GRAPH_HEADLESS
+	// used by node GUI, e.g. to pick particle vertex declaration
+	StudioApp* m_app = nullptr;
+#endif
+};
+
+} // namespace Lumix
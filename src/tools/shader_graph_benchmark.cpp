@@ -0,0 +1,310 @@
+#include "core/allocators.h"
+#include "core/array.h"
+#include "core/crt.h"
+#include "core/log.h"
+#include "core/math.h"
+#include "core/os.h"
+#include "core/path.h"
+#include "core/stream.h"
+#include "core/string.h"
+#include "engine/file_system.h"
+#include "../editor/shader_graph.h"
+#include <stdio.h>
+
+// measures codegen on synthetic graphs, prints one json object per line, so runs can be compared by scripts
+// usage: shader_graph_benchmark <work dir> [-size <nodes>] [-repeat <count>] [-case chain|fanout|functions|samples]
+// function graphs are written to <work dir>/benchmark
+
+using namespace Lumix;
+
+namespace {
+
+using Node = ShaderEditorResource::Node;
+
+// tracks live and peak size of allocations
+struct CountingAllocator final : IAllocator {
+	explicit CountingAllocator(IAllocator& parent) : m_parent(parent) {}
+
+	void* allocate(size_t size, size_t align) override {
+		// size and offset are stored in front of the block
+		const size_t offset = maximum(align, (size_t)16);
+		u8* mem = (u8*)m_parent.allocate(size + offset, offset);
+		if (!mem) return nullptr;
+		u8* ptr = mem + offset;
+		((size_t*)ptr)[-1] = size;
+		((size_t*)ptr)[-2] = offset;
+		m_current += size;
+		m_peak = maximum(m_peak, m_current);
+		return ptr;
+	}
+
+	void deallocate(void* ptr) override {
+		if (!ptr) return;
+		m_current -= ((size_t*)ptr)[-1];
+		m_parent.deallocate((u8*)ptr - ((size_t*)ptr)[-2]);
+	}
+
+	void* reallocate(void* ptr, size_t new_size, size_t old_size, size_t align) override {
+		void* res = allocate(new_size, align);
+		if (ptr) {
+			memcpy(res, ptr, minimum(new_size, old_size));
+			deallocate(ptr);
+		}
+		return res;
+	}
+
+	void resetPeak() { m_peak = m_current; }
+
+	IAllocator& m_parent;
+	size_t m_current = 0;
+	size_t m_peak = 0;
+};
+
+// builds graphs through the same API the editor uses
+struct GraphBuilder {
+	GraphBuilder(ShaderEditorResource& resource, IAllocator& allocator) : resource(resource), allocator(allocator) {}
+
+	Node* add(ShaderNodeType type) {
+		Node* n = resource.createNode((int)type);
+		n->m_id = ++resource.m_last_node_id;
+		resource.addNode(n);
+		return n;
+	}
+
+	// node with a string parameter, e.g. parameter name or texture path
+	Node* add(ShaderNodeType type, const char* param) {
+		Node* n = add(type);
+		OutputMemoryStream blob(allocator);
+		blob.writeString(param);
+		InputMemoryStream input(blob);
+		n->deserialize(input);
+		return n;
+	}
+
+	Node* addParam(u32 idx) {
+		const StaticString<32> name("p", idx);
+		return add(ShaderNodeType::SCALAR_PARAM, name);
+	}
+
+	void link(Node* from, u32 from_pin, Node* to, u32 to_pin) {
+		resource.addLink({u32(from->m_id) | (from_pin << 16), u32(to->m_id) | (to_pin << 16)});
+	}
+
+	// a + b
+	Node* add(Node* a, Node* b) {
+		Node* n = add(ShaderNodeType::ADD);
+		link(a, 0, n, 0);
+		link(b, 0, n, 1);
+		return n;
+	}
+
+	// nodes not connected to the output, so deleteUnreachable has work
+	void addUnreachable(u32 count) {
+		Node* prev = addParam(0xffFF);
+		for (u32 i = 0; i < count; ++i) prev = add(prev, prev);
+	}
+
+	ShaderEditorResource& resource;
+	IAllocator& allocator;
+};
+
+// each node uses the previous one, i.e. deeply nested expressions
+void buildChain(GraphBuilder& builder, u32 size) {
+	Node* param = builder.addParam(0);
+	Node* prev = param;
+	for (u32 i = 0; i < size; ++i) prev = builder.add(prev, param);
+	builder.link(prev, 0, builder.resource.m_nodes[0], 0);
+}
+
+// layers of nodes, each using two nodes of the previous layer, shared subexpressions are used many times
+void buildFanout(GraphBuilder& builder, u32 size) {
+	const u32 width = maximum(2u, (u32)sqrtf((float)size));
+	Array<Node*> layer(builder.allocator);
+	Array<Node*> next(builder.allocator);
+	for (u32 i = 0; i < width; ++i) layer.push(builder.addParam(i));
+	for (u32 depth = 0; depth < size / width; ++depth) {
+		next.clear();
+		for (u32 i = 0; i < width; ++i) next.push(builder.add(layer[i], layer[(i * 7 + depth + 1) % width]));
+		layer.clear();
+		for (Node* n : next) layer.push(n);
+	}
+	Node* sum = layer[0];
+	for (u32 i = 1; i < width; ++i) sum = builder.add(sum, layer[i]);
+	builder.link(sum, 0, builder.resource.m_nodes[0], 0);
+}
+
+// many texture fetches added together
+void buildSamples(GraphBuilder& builder, u32 size) {
+	Node* uv = builder.add(ShaderNodeType::UV0);
+	Node* sum = nullptr;
+	for (u32 i = 0; i < size; ++i) {
+		const StaticString<32> texture("textures/benchmark_", i % 16, ".tga");
+		Node* sample = builder.add(ShaderNodeType::SAMPLE, texture);
+		builder.link(uv, 0, sample, 0);
+		sum = sum ? builder.add(sum, sample) : sample;
+	}
+	if (sum) builder.link(sum, 0, builder.resource.m_nodes[0], 0);
+}
+
+// fn_i(x) = x + fn_{i + 1}(x), the surface calls fn_0
+bool buildFunctions(ShaderGraphCompiler& compiler, GraphBuilder& builder, u32 size, IAllocator& allocator) {
+	const u32 depth = maximum(1u, size / 4);
+	ShaderEditorResource* callee = nullptr;
+	for (i32 i = depth - 1; i >= 0; --i) {
+		const Path path("benchmark/fn_", i, ".sfn");
+		ShaderEditorResource fn(path, compiler, allocator);
+		fn.init(ShaderResourceEditorType::FUNCTION);
+		GraphBuilder fn_builder(fn, allocator);
+		OutputMemoryStream input_params(allocator);
+		input_params.writeString("x");
+		input_params.write(ShaderEditorResource::ValueType::FLOAT);
+		Node* x = fn_builder.add(ShaderNodeType::FUNCTION_INPUT);
+		InputMemoryStream input_blob(input_params);
+		x->deserialize(input_blob);
+		Node* result = x;
+		if (callee) {
+			Node* call = fn_builder.add(ShaderNodeType::FUNCTION_CALL);
+			ShaderEditorResource::setCalledFunction(*call, callee);
+			fn_builder.link(x, 0, call, 0);
+			result = fn_builder.add(x, call);
+		}
+		fn_builder.link(result, 0, fn.m_nodes[0], 0);
+
+		OutputMemoryStream blob(allocator);
+		fn.serialize(blob);
+		if (!compiler.m_fs.saveContentSync(path, blob)) {
+			logError("Failed to write ", path);
+			return false;
+		}
+		compiler.addFunction(path);
+		callee = compiler.m_function_library.find(path, true);
+		if (!callee) return false;
+	}
+
+	Node* call = builder.add(ShaderNodeType::FUNCTION_CALL);
+	ShaderEditorResource::setCalledFunction(*call, callee);
+	builder.link(builder.addParam(0), 0, call, 0);
+	builder.link(call, 0, builder.resource.m_nodes[0], 0);
+	return true;
+}
+
+struct Result {
+	float generate = 1e30f;
+	float reachable = 1e30f;
+	float serialize = 1e30f;
+	float deserialize = 1e30f;
+	float delete_unreachable = 1e30f;
+	size_t generate_peak = 0;
+	size_t graph_memory = 0;
+	u32 output_size = 0;
+	u32 serialized_size = 0;
+	u32 nodes = 0;
+	u32 links = 0;
+};
+
+void logToStderr(LogLevel level, const char* message) {
+	fprintf(stderr, "%s\n", message);
+}
+
+bool runCase(const char* name, ShaderGraphCompiler& compiler, u32 size, u32 repeat, CountingAllocator& allocator) {
+	Result result;
+	for (u32 iteration = 0; iteration < repeat; ++iteration) {
+		const size_t memory_before = allocator.m_current;
+		ShaderEditorResource res(Path("benchmark/graph.sed"), compiler, allocator);
+		res.init(ShaderResourceEditorType::SURFACE);
+		GraphBuilder builder(res, allocator);
+		if (equalStrings(name, "chain")) buildChain(builder, size);
+		else if (equalStrings(name, "fanout")) buildFanout(builder, size);
+		else if (equalStrings(name, "samples")) buildSamples(builder, size);
+		else if (!buildFunctions(compiler, builder, size, allocator)) return false;
+		builder.addUnreachable(size / 4);
+		result.graph_memory = allocator.m_current - memory_before;
+		result.nodes = res.m_nodes.size();
+		result.links = res.m_links.size();
+
+		os::Timer timer;
+		res.markReachableNodes();
+		result.reachable = minimum(result.reachable, timer.tick());
+
+		allocator.resetPeak();
+		const size_t memory_before_generate = allocator.m_current;
+		String source(allocator);
+		timer.tick();
+		if (!res.generate(&source)) {
+			logError(name, ": generate failed");
+			return false;
+		}
+		result.generate = minimum(result.generate, timer.tick());
+		result.generate_peak = allocator.m_peak - memory_before_generate;
+		result.output_size = source.length();
+
+		OutputMemoryStream blob(allocator);
+		timer.tick();
+		res.serialize(blob);
+		result.serialize = minimum(result.serialize, timer.tick());
+		result.serialized_size = (u32)blob.size();
+
+		ShaderEditorResource copy(res.m_path, compiler, allocator);
+		InputMemoryStream input(blob);
+		timer.tick();
+		if (!copy.deserialize(input)) {
+			logError(name, ": deserialize failed");
+			return false;
+		}
+		result.deserialize = minimum(result.deserialize, timer.tick());
+
+		res.deleteUnreachable();
+		result.delete_unreachable = minimum(result.delete_unreachable, timer.tick());
+	}
+
+	printf("{\"case\": \"%s\", \"size\": %u, \"nodes\": %u, \"links\": %u"
+		", \"generate_ms\": %.3f, \"reachable_ms\": %.3f"
+		", \"serialize_ms\": %.3f, \"deserialize_ms\": %.3f, \"delete_unreachable_ms\": %.3f"
+		", \"generate_peak_bytes\": %zu, \"graph_bytes\": %zu, \"output_bytes\": %u, \"serialized_bytes\": %u}\n"
+		, name, size, result.nodes, result.links
+		, result.generate * 1000, result.reachable * 1000
+		, result.serialize * 1000, result.deserialize * 1000, result.delete_unreachable * 1000
+		, result.generate_peak, result.graph_memory, result.output_size, result.serialized_size);
+	fflush(stdout);
+	return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printf("usage: shader_graph_benchmark <work dir> [-size <nodes>] [-repeat <count>] [-case chain|fanout|functions|samples]\n");
+		return 1;
+	}
+	registerLogCallback<&logToStderr>();
+
+	u32 size = 1000;
+	u32 repeat = 5;
+	const char* single_case = nullptr;
+	for (i32 i = 2; i + 1 < argc; i += 2) {
+		if (equalStrings(argv[i], "-size")) fromCString(argv[i + 1], size);
+		else if (equalStrings(argv[i], "-repeat")) fromCString(argv[i + 1], repeat);
+		else if (equalStrings(argv[i], "-case")) single_case = argv[i + 1];
+	}
+	repeat = maximum(repeat, 1u);
+
+	DefaultAllocator default_allocator;
+	CountingAllocator allocator(default_allocator);
+	UniquePtr<FileSystem> fs = FileSystem::create(argv[1], allocator);
+	const StaticString<MAX_PATH> dir(argv[1], "/benchmark");
+	if (!os::makePath(dir)) {
+		logError("Failed to create ", dir);
+		return 1;
+	}
+
+	bool success = true;
+	{
+		ShaderGraphCompiler compiler(*fs, allocator, false);
+		const char* cases[] = { "chain", "fanout", "functions", "samples" };
+		for (const char* name : cases) {
+			if (single_case && !equalStrings(single_case, name)) continue;
+			success = runCase(name, compiler, size, repeat, allocator) && success;
+		}
+	}
+	return success ? 0 : 1;
+}
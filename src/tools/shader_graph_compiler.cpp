@@ -0,0 +1,178 @@
+#include "core/allocators.h"
+#include "core/array.h"
+#include "core/log.h"
+#include "core/os.h"
+#include "core/path.h"
+#include "core/stream.h"
+#include "core/string.h"
+#include "engine/file_system.h"
+#include "../editor/shader_graph.h"
+#include <stdio.h>
+
+// converts shader graphs to shaders without the studio, e.g. to pre-bake them on a build machine
+// usage: shader_graph_compiler <project dir> <output dir> [<directory in project>] [-report <file>]
+
+using namespace Lumix;
+
+namespace {
+
+struct Timings {
+	float load = 0;
+	float deserialize = 0;
+	float codegen = 0;
+	float write = 0;
+};
+
+void logToStdout(LogLevel level, const char* message) {
+	if (level == LogLevel::ERROR) fprintf(stderr, "%s\n", message);
+	else printf("%s\n", message);
+}
+
+// `dir` is relative to the project
+void collectGraphs(const char* project_dir, const char* dir, Array<Path>& graphs, IAllocator& allocator) {
+	const StaticString<MAX_PATH> native_dir(project_dir, "/", dir);
+	os::FileIterator* iter = os::createFileIterator(native_dir, allocator);
+	os::FileInfo info;
+	while (os::getNextFile(iter, &info)) {
+		if (info.filename[0] == '.') continue;
+
+		const StaticString<MAX_PATH> path(dir, dir[0] ? "/" : "", info.filename);
+		if (info.is_directory) collectGraphs(project_dir, path, graphs, allocator);
+		else if (Path::hasExtension(path, "sed")) graphs.emplace(path);
+	}
+	os::destroyFileIterator(iter);
+}
+
+bool writeFile(const char* path, const void* data, u64 size) {
+	os::OutputFile file;
+	if (!file.open(path)) {
+		logError("Failed to create ", path);
+		return false;
+	}
+	const bool written = file.write(data, size);
+	file.close();
+	if (!written) {
+		logError("Failed to write ", path);
+		return false;
+	}
+	return true;
+}
+
+// `report` is null if the report is not requested
+bool compileGraph(ShaderGraphCompiler& compiler, const Path& path, const char* output_dir, OutputMemoryStream* report, IAllocator& allocator, Timings& timings) {
+	os::Timer timer;
+	OutputMemoryStream content(allocator);
+	if (!compiler.m_fs.getContentSync(path, content)) {
+		logError("Failed to read ", path);
+		return false;
+	}
+	timings.load = timer.tick();
+
+	ShaderEditorResource res(path, compiler, allocator);
+	InputMemoryStream blob(content);
+	if (!res.deserialize(blob)) {
+		logError("Failed to deserialize ", path);
+		return false;
+	}
+	// functions are deserialized lazily, they are part of codegen time
+	timings.deserialize = timer.tick();
+
+	String source(allocator);
+	if (!res.generate(&source)) {
+		for (const ShaderEditorResource::Node* n : res.m_nodes) {
+			if (n->m_error.length() > 0) logError(path, ": node ", n->m_id, ": ", n->m_error.c_str());
+		}
+		return false;
+	}
+	timings.codegen = timer.tick();
+
+	if (report) res.writeCostReport(*report);
+	if (!res.checkCostBudget()) return false;
+
+	const StaticString<MAX_PATH> out_path(output_dir, "/", path, ".shd");
+	const StaticString<MAX_PATH> out_dir(Path::getDir(out_path));
+	if (!os::makePath(out_dir)) {
+		logError("Failed to create ", out_dir);
+		return false;
+	}
+	if (!writeFile(out_path, source.c_str(), source.length())) return false;
+
+	if (!res.m_packed_textures.empty()) {
+		OutputMemoryStream manifest(allocator);
+		res.writePackingManifest(manifest);
+		const StaticString<MAX_PATH> manifest_path(output_dir, "/", path, ".packing");
+		if (!writeFile(manifest_path, manifest.data(), manifest.size())) return false;
+	}
+
+	if (!res.m_particle_streams.empty()) {
+		OutputMemoryStream manifest(allocator);
+		res.writeParticleStreamsManifest(manifest);
+		const StaticString<MAX_PATH> manifest_path(output_dir, "/", path, ".particles");
+		if (!writeFile(manifest_path, manifest.data(), manifest.size())) return false;
+	}
+	timings.write = timer.tick();
+	return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printf("usage: shader_graph_compiler <project dir> <output dir> [<directory in project>] [-report <file>]\n");
+		return 1;
+	}
+	const char* dir = "";
+	const char* report_path = nullptr;
+	for (int i = 3; i < argc; ++i) {
+		if (equalStrings(argv[i], "-report") && i + 1 < argc) report_path = argv[++i];
+		else dir = argv[i];
+	}
+	registerLogCallback<&logToStdout>();
+
+	DefaultAllocator allocator;
+	UniquePtr<FileSystem> fs = FileSystem::create(argv[1], allocator);
+	// there's no job system, functions are loaded on the calling thread
+	ShaderGraphCompiler compiler(*fs, allocator, false);
+
+	Array<Path> graphs(allocator);
+	collectGraphs(argv[1], dir, graphs, allocator);
+	OutputMemoryStream report(allocator);
+
+	u32 failed = 0;
+	Timings total;
+	for (const Path& path : graphs) {
+		Timings timings;
+		os::Timer timer;
+		const bool success = compileGraph(compiler, path, argv[2], report_path ? &report : nullptr, allocator, timings);
+		compiler.onGraphCompiled(path, success, timer.getTimeSinceStart());
+		if (!success) {
+			++failed;
+			continue;
+		}
+		printf("%s: load %.3f ms, deserialize %.3f ms, codegen %.3f ms, write %.3f ms\n"
+			, path.c_str()
+			, timings.load * 1000
+			, timings.deserialize * 1000
+			, timings.codegen * 1000
+			, timings.write * 1000);
+		total.load += timings.load;
+		total.deserialize += timings.deserialize;
+		total.codegen += timings.codegen;
+		total.write += timings.write;
+	}
+
+	printf("%d graphs, %d failed: load %.3f ms, deserialize %.3f ms, codegen %.3f ms, write %.3f ms\n"
+		, graphs.size()
+		, failed
+		, total.load * 1000
+		, total.deserialize * 1000
+		, total.codegen * 1000
+		, total.write * 1000);
+	const ShaderGraphCompiler::Stats& stats = compiler.m_stats;
+	printf("function cache: %d hits, %d misses, generated %d bytes", (i32)stats.function_cache_hits, (i32)stats.function_cache_misses, (i32)(i64)stats.emitted_bytes);
+	if (!stats.slowest_graph.isEmpty()) printf(", slowest %s (%.3f ms)", stats.slowest_graph.c_str(), stats.slowest_graph_time * 1000);
+	printf("\n");
+
+	if (report_path && !writeFile(report_path, report.data(), report.size())) return 1;
+	return failed > 0 ? 1 : 0;
+}